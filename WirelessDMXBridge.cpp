@@ -0,0 +1,234 @@
+/*
+  WirelessDMXBridge.cpp - Forward received universes to the network as Art-Net or sACN (E1.31)
+  Released into the public domain.
+*/
+
+#include "WirelessDMXBridge.h"
+
+WirelessDMXBridge::WirelessDMXBridge(wdmxBridgeProtocol_t protocol)
+{
+  _protocol = protocol;
+  _headerSize = (protocol == WDMX_BRIDGE_SACN) ? WDMX_SACN_HEADER_SIZE : WDMX_ARTNET_HEADER_SIZE;
+}
+
+WirelessDMXBridge::~WirelessDMXBridge()
+{
+  // Make sure that no receiver notifies the task after it is gone
+  _removeCallbacks();
+  _stopTask();
+  if (_socket >= 0) {
+    close(_socket);
+  }
+}
+
+bool WirelessDMXBridge::add(WirelessDMXReceiver& receiver, uint16_t universe)
+{
+  if ((_count >= WDMX_BRIDGE_MAX_UNIVERSES) || (_bridgeTask != nullptr)) {
+    return(false);
+  }
+  _universes[_count].receiver = &receiver;
+  _universes[_count].universe = universe;
+  _universes[_count].sequence = 0;
+  _universes[_count].changeGeneration = 0;
+  _universes[_count].lastSent = 0;
+  _universes[_count].frameCallback = -1;
+  _count++;
+  return(true);
+}
+
+void WirelessDMXBridge::_removeCallbacks()
+{
+  for (size_t i = 0; i < _count; i++) {
+    _universes[i].receiver->removeFrameCallback(_universes[i].frameCallback);
+    _universes[i].frameCallback = -1;
+  }
+}
+
+/*
+ * Let the bridge task finish its current pass and exit. Deleting it from here could catch it inside sendto(),
+ * holding lwIP resources.
+ */
+void WirelessDMXBridge::_stopTask()
+{
+  if (!_taskRunning) {
+    return;
+  }
+  _stopRequested = true;
+  xTaskNotifyGive(_bridgeTask);
+  while (_taskRunning) {
+    delay(1);
+  }
+  _bridgeTask = nullptr;
+}
+
+bool WirelessDMXBridge::begin(const char* destination, BaseType_t core, UBaseType_t priority)
+{
+  int enable = 1;
+
+  if (destination != nullptr) {
+    if (inet_pton(AF_INET, destination, &_destination) != 1) {
+      return(false);
+    }
+  }
+
+  _socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (_socket < 0) {
+    return(false);
+  }
+  if ((_protocol == WDMX_BRIDGE_ARTNET) && (_destination == 0)) {
+    setsockopt(_socket, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+  }
+
+  _initPacket();
+
+  _stopRequested = false;
+  _taskRunning = true;
+  xTaskCreatePinnedToCore(
+    _startBridgeThread,           /* Function to implement the task */
+    "DMX Bridge Thread",          /* Name of the task */
+    WDMX_BRIDGE_TASK_STACK_SIZE,  /* Stack size in bytes */
+    this,                         /* Task input parameter */
+    priority,                     /* Priority of the task */
+    &_bridgeTask,                 /* Task handle. */
+    core                          /* Core where the task should run */
+  );
+
+  TaskHandle_t bridgeTask = _bridgeTask;
+  for (size_t i = 0; i < _count; i++) {
+    _universes[i].frameCallback = _universes[i].receiver->addFrameCallback([bridgeTask]() { xTaskNotifyGive(bridgeTask); });
+    if (_universes[i].frameCallback < 0) {
+      _removeCallbacks();
+      _stopTask();
+      close(_socket);
+      _socket = -1;
+      return(false);
+    }
+  }
+  return(true);
+}
+
+/*
+ * Fill in the parts of the packet header that are the same for every universe and every packet.
+ */
+void WirelessDMXBridge::_initPacket()
+{
+  uint8_t* p = _packet;
+
+  memset(_packet, 0, sizeof(_packet));
+  if (_protocol == WDMX_BRIDGE_ARTNET) {
+    memcpy(&p[0], "Art-Net", 8);                  // ID, including the terminating zero
+    p[8] = 0x00;                                  // OpCode OpDmx (0x5000), little endian
+    p[9] = 0x50;
+    p[10] = 0;                                    // Protocol version 14
+    p[11] = 14;
+    return;
+  }
+
+  uint64_t mac = ESP.getEfuseMac();
+
+  // Root layer. The flags and length fields of all three layers depend on the universe size, see _send().
+  p[1] = 0x10;                                    // Preamble size
+  memcpy(&p[4], "ASC-E1.17", 9);                  // ACN packet identifier, zero padded to 12 bytes
+  p[21] = 0x04;                                   // VECTOR_ROOT_E131_DATA
+  memcpy(&p[22], "WDMX", 4);                      // CID: needs to be unique and stable for this device
+  memcpy(&p[26], &mac, 6);
+
+  // Framing layer
+  p[43] = 0x02;                                   // VECTOR_E131_DATA_PACKET
+  strncpy((char*)&p[44], "WirelessDMXReceiver", 64);  // Source name
+  p[108] = WDMX_SACN_PRIORITY;
+
+  // DMP layer
+  p[117] = 0x02;                                  // VECTOR_DMP_SET_PROPERTY
+  p[118] = 0xA1;                                  // Address and data type
+  p[122] = 0x01;                                  // Address increment
+}
+
+/*
+ * Store a 12 bit PDU length with the flags (0x7) in the upper four bits.
+ */
+static void _setPDULength(uint8_t* p, size_t length)
+{
+  p[0] = 0x70 | ((length >> 8) & 0x0F);
+  p[1] = length & 0xFF;
+}
+
+/*
+ * Fill in the universe, sequence number and data of the packet and send it.
+ */
+void WirelessDMXBridge::_send(wdmxBridgeUniverse& universe)
+{
+  struct sockaddr_in dest = {};
+  uint8_t* p = _packet;
+  size_t length = universe.receiver->getChannelCount();
+
+  dest.sin_family = AF_INET;
+  dest.sin_addr.s_addr = _destination;
+  if (_protocol == WDMX_BRIDGE_ARTNET) {
+    dest.sin_port = htons(WDMX_ARTNET_PORT);
+    if (_destination == 0) {
+      dest.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    }
+    // Art-Net sequence numbers run from 1 to 255; 0 disables sequencing
+    universe.sequence = (universe.sequence == 255) ? 1 : (universe.sequence + 1);
+    p[12] = universe.sequence;
+    p[14] = universe.universe & 0xFF;             // SubUni
+    p[15] = (universe.universe >> 8) & 0x7F;      // Net
+    length = max(length + (length & 1), (size_t)2); // Data length must be even, and at least 2
+    p[16] = length >> 8;
+    p[17] = length & 0xFF;
+  } else {
+    dest.sin_port = htons(WDMX_SACN_PORT);
+    if (_destination == 0) {
+      dest.sin_addr.s_addr = htonl(0xEFFF0000 | universe.universe);  // 239.255.<universe>
+    }
+    p[111] = universe.sequence++;
+    p[113] = universe.universe >> 8;
+    p[114] = universe.universe & 0xFF;
+    _setPDULength(&p[16], WDMX_SACN_HEADER_SIZE + length - 16);
+    _setPDULength(&p[38], WDMX_SACN_HEADER_SIZE + length - 38);
+    _setPDULength(&p[115], WDMX_SACN_HEADER_SIZE + length - 115);
+    p[123] = (length + 1) >> 8;                   // Property value count, including the start code
+    p[124] = (length + 1) & 0xFF;
+  }
+
+  universe.receiver->readSnapshot(&_packet[_headerSize], length);
+  if (sendto(_socket, _packet, _headerSize + length, 0, (struct sockaddr*)&dest, sizeof(dest)) < 0) {
+    _sendErrors = _sendErrors + 1;
+  } else {
+    _packetsSent = _packetsSent + 1;
+  }
+}
+
+void WirelessDMXBridge::_startBridgeThread(void* _this)
+{
+  ((WirelessDMXBridge*)_this)->_bridgeLoop();
+}
+
+void WirelessDMXBridge::_bridgeLoop()
+{
+  while (!_stopRequested) {
+    // Woken by any of the receivers as soon as it published a frame. Wake up more often than the keep-alive
+    // interval anyway, so that keep-alives are sent in time while no frames arrive.
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WDMX_BRIDGE_KEEPALIVE_MS / 4));
+
+    unsigned long now = millis();
+    for (size_t i = 0; i < _count; i++) {
+      wdmxBridgeUniverse& universe = _universes[i];
+      uint32_t generation = universe.receiver->changeGeneration();
+
+      if (universe.receiver->frameGeneration() == 0) {
+        continue; // Nothing received yet; don't send keep-alives with an all-zero universe
+      }
+      if ((generation == universe.changeGeneration) && (now - universe.lastSent < WDMX_BRIDGE_KEEPALIVE_MS)) {
+        continue;
+      }
+      universe.changeGeneration = generation;
+      universe.lastSent = now;
+      _send(universe);
+    }
+  }
+
+  _taskRunning = false;   // _stopTask() returns once this is cleared; don't touch any members after this
+  vTaskDelete(nullptr);
+}
@@ -0,0 +1,90 @@
+/*
+  WirelessDMXBridge.h - Forward received universes to the network as Art-Net or sACN (E1.31)
+  Released into the public domain.
+*/
+
+#ifndef WirelessDMXBridge_h
+#define WirelessDMXBridge_h
+
+#include "Arduino.h"
+#include <lwip/sockets.h>
+#include "WirelessDMXReceiver.h"
+
+#define WDMX_BRIDGE_MAX_UNIVERSES       4   // Maximum number of receivers forwarded by one bridge
+#define WDMX_BRIDGE_KEEPALIVE_MS     1000   // Re-send an unchanged universe this often
+#define WDMX_BRIDGE_TASK_PRIORITY       5   // Below the receive task, above the Arduino loop task
+#define WDMX_BRIDGE_TASK_STACK_SIZE  4096   // In bytes. sendto() goes through lwIP, which needs some stack.
+#define WDMX_ARTNET_PORT             6454
+#define WDMX_ARTNET_HEADER_SIZE        18   // ArtDmx header up to the DMX data
+#define WDMX_SACN_PORT               5568
+#define WDMX_SACN_HEADER_SIZE         126   // E1.31 root, framing and DMP layers up to the DMX data (incl. start code)
+#define WDMX_SACN_PRIORITY            100   // E1.31 default priority
+
+enum wdmxBridgeProtocol_t {                 // Network protocol a WirelessDMXBridge sends
+  WDMX_BRIDGE_ARTNET = 0,                   // Art-Net ArtDmx, broadcast by default
+  WDMX_BRIDGE_SACN = 1                      // sACN (E1.31), to the universe's multicast group by default
+};
+
+/*
+ * Sends the universes received by one or more WirelessDMXReceivers to the network.
+ *
+ * The bridge task is woken by the receivers' frame callbacks, so it sends as soon as a universe is complete. A
+ * universe is only sent if any of its channels changed since it was last sent (see changeGeneration()), or if
+ * WDMX_BRIDGE_KEEPALIVE_MS passed. All packets are assembled in a single preallocated buffer.
+ */
+class WirelessDMXBridge
+{
+  public:
+    WirelessDMXBridge(wdmxBridgeProtocol_t protocol);
+    ~WirelessDMXBridge();
+
+    /*
+     * Forward the given receiver as universe. Art-Net universes (port addresses) are 0..32767, sACN universes
+     * 1..63999. Must be called before begin(), and before the receiver's begin(). Returns false if the bridge
+     * is full.
+     */
+    bool add(WirelessDMXReceiver& receiver, uint16_t universe);
+
+    /*
+     * Open the socket and start the bridge task. Call this once the network is up, but before the receivers'
+     * begin(). destination is the IPv4 address to send to; nullptr selects the protocol default (broadcast for
+     * Art-Net, multicast for sACN).
+     */
+    bool begin(const char* destination = nullptr, BaseType_t core = tskNO_AFFINITY, UBaseType_t priority = WDMX_BRIDGE_TASK_PRIORITY);
+
+    uint32_t packetsSent() const { return(_packetsSent); };
+    uint32_t sendErrors() const { return(_sendErrors); };
+
+  private:
+    struct wdmxBridgeUniverse {
+      WirelessDMXReceiver* receiver;
+      uint16_t universe;
+      uint8_t sequence;
+      uint32_t changeGeneration;  // changeGeneration() of the receiver when we last sent it
+      unsigned long lastSent;     // millis() when we last sent it
+      int frameCallback;          // Index of our frame callback on the receiver, -1 if none
+    };
+
+    void _removeCallbacks();
+    void _stopTask();
+
+    void _initPacket();
+    void _send(wdmxBridgeUniverse& universe);
+    void _bridgeLoop();
+    static void _startBridgeThread(void*);
+
+    wdmxBridgeProtocol_t _protocol;
+    wdmxBridgeUniverse _universes[WDMX_BRIDGE_MAX_UNIVERSES];
+    size_t _count = 0;
+    uint8_t _packet[WDMX_SACN_HEADER_SIZE + DMX_BUFSIZE];
+    size_t _headerSize;
+    int _socket = -1;
+    uint32_t _destination = 0;  // In network byte order. 0 selects the protocol default.
+    TaskHandle_t _bridgeTask = nullptr;
+    volatile bool _taskRunning = false;
+    volatile bool _stopRequested = false;  // Asks the bridge task to exit, see _stopTask()
+    volatile uint32_t _packetsSent = 0;
+    volatile uint32_t _sendErrors = 0;
+};
+
+#endif
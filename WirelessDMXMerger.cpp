@@ -0,0 +1,254 @@
+/*
+  WirelessDMXMerger.cpp - Merge the universes of several receivers (HTP, LTP or primary/backup)
+  Released into the public domain.
+*/
+
+#include "WirelessDMXMerger.h"
+
+#define WDMX_BYTE_HIGH_BITS  0x80808080UL
+
+WirelessDMXMerger::WirelessDMXMerger(wdmxMergePolicy_t policy)
+{
+  _policy = policy;
+  memset(_inputs, 0x00, sizeof(_inputs));
+  memset(_previous, 0x00, sizeof(_previous));
+  memset(_owner, 0x00, sizeof(_owner));
+  memset(_frames, 0x00, sizeof(_frames));
+  _frontBuffer.store(_frames[2]);
+}
+
+WirelessDMXMerger::~WirelessDMXMerger()
+{
+  // Make sure that no source notifies the task after it is gone
+  _removeCallbacks();
+  _stopTask();
+}
+
+bool WirelessDMXMerger::add(WirelessDMXReceiver& receiver)
+{
+  if ((_count >= WDMX_MERGE_MAX_SOURCES) || (_mergeTask != nullptr)) {
+    return(false);
+  }
+  _sources[_count] = &receiver;
+  _callbacks[_count] = -1;
+  _count++;
+  return(true);
+}
+
+void WirelessDMXMerger::_removeCallbacks()
+{
+  for (unsigned int i = 0; i < _count; i++) {
+    _sources[i]->removeFrameCallback(_callbacks[i]);
+    _callbacks[i] = -1;
+  }
+}
+
+/*
+ * Let the merge task finish its current pass and exit, rather than deleting it wherever it is.
+ */
+void WirelessDMXMerger::_stopTask()
+{
+  if (!_taskRunning) {
+    return;
+  }
+  _stopRequested = true;
+  xTaskNotifyGive(_mergeTask);
+  while (_taskRunning) {
+    delay(1);
+  }
+  _mergeTask = nullptr;
+}
+
+bool WirelessDMXMerger::begin(BaseType_t core, UBaseType_t priority)
+{
+  _stopRequested = false;
+  _taskRunning = true;
+  xTaskCreatePinnedToCore(
+    _startMergeThread,            /* Function to implement the task */
+    "DMX Merge Thread",           /* Name of the task */
+    WDMX_MERGE_TASK_STACK_SIZE,   /* Stack size in bytes */
+    this,                         /* Task input parameter */
+    priority,                     /* Priority of the task */
+    &_mergeTask,                  /* Task handle. */
+    core                          /* Core where the task should run */
+  );
+
+  TaskHandle_t mergeTask = _mergeTask;
+  for (unsigned int i = 0; i < _count; i++) {
+    _callbacks[i] = _sources[i]->addFrameCallback([mergeTask]() { xTaskNotifyGive(mergeTask); });
+    if (_callbacks[i] < 0) {
+      _removeCallbacks();
+      _stopTask();
+      return(false);
+    }
+  }
+  return(true);
+}
+
+/*
+ * See WirelessDMXReceiver::readSnapshot(). The merger always publishes through its own triple buffer.
+ */
+bool WirelessDMXMerger::readSnapshot(uint8_t* dst, size_t len, uint32_t* gen) const
+{
+  uint32_t startGeneration = _frameGeneration.load(std::memory_order_acquire);
+
+  if ((gen != nullptr) && (*gen == startGeneration)) {
+    return(false);
+  }
+
+  len = min(len, (size_t)DMX_BUFSIZE);
+  while (true) {
+    memcpy(dst, getFrame(), len);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (_frameGeneration.load(std::memory_order_relaxed) - startGeneration < 2) {
+      break;
+    }
+    startGeneration = _frameGeneration.load(std::memory_order_acquire);
+  }
+
+  if (gen != nullptr) {
+    *gen = startGeneration;
+  }
+  return(true);
+}
+
+bool WirelessDMXMerger::_alive(unsigned int source) const
+{
+  unsigned long lastPacket = _sources[source]->lastPacketMillis();   // Before millis(), so this can't underflow
+
+  return(_sources[source]->isLocked() && (millis() - lastPacket < WDMX_MERGE_TIMEOUT_MS));
+}
+
+/*
+ * out = bytewise maximum of the inputs of all sources in the bitmap, four channels at a time.
+ *
+ * Per byte, (a | 0x80) - (b & 0x7F) can't borrow from the next byte, and its top bit tells whether the low seven
+ * bits of a are >= those of b. Combined with the top bits of a and b, that yields a >= b in the top bit of every
+ * byte, which is then widened into a byte mask to select a or b.
+ */
+void WirelessDMXMerger::_mergeHTP(uint32_t* out, uint32_t sources)
+{
+  bool first = true;
+
+  while (sources != 0) {
+    const uint32_t* in = (const uint32_t*)_inputs[__builtin_ctz(sources)];
+    sources &= sources - 1;
+
+    if (first) {
+      memcpy(out, in, DMX_BUFSIZE);
+      first = false;
+      continue;
+    }
+    for (unsigned int i = 0; i < DMX_BUFSIZE / 4; i++) {
+      uint32_t a = in[i];
+      uint32_t b = out[i];
+      uint32_t low = (a | WDMX_BYTE_HIGH_BITS) - (b & ~WDMX_BYTE_HIGH_BITS);
+      uint32_t ge = ((a & ~b) | (~(a ^ b) & low)) & WDMX_BYTE_HIGH_BITS;
+      uint32_t mask = (ge >> 7) * 0xFF;
+      out[i] = (a & mask) | (b & ~mask);
+    }
+  }
+}
+
+/*
+ * Hand every channel that changed in one of the updated sources to that source, then compose the output from the
+ * owners of all channels. Channels owned by a source that no longer takes part go to the first one that does.
+ */
+void WirelessDMXMerger::_mergeLTP(uint8_t* out, uint32_t sources, uint32_t updated)
+{
+  uint8_t fallback = __builtin_ctz(sources);
+
+  while (updated != 0) {
+    unsigned int source = __builtin_ctz(updated);
+    const uint32_t* in = (const uint32_t*)_inputs[source];
+    const uint32_t* previous = (const uint32_t*)_previous[source];
+    updated &= updated - 1;
+
+    // Compare four channels at a time; only look at individual channels of words that changed
+    for (unsigned int i = 0; i < DMX_BUFSIZE / 4; i++) {
+      if (in[i] != previous[i]) {
+        for (unsigned int channel = i * 4; channel < i * 4 + 4; channel++) {
+          if (_inputs[source][channel] != _previous[source][channel]) {
+            _owner[channel] = source;
+          }
+        }
+      }
+    }
+    memcpy(_previous[source], _inputs[source], DMX_BUFSIZE);
+  }
+
+  for (unsigned int channel = 0; channel < DMX_BUFSIZE; channel++) {
+    uint8_t owner = _owner[channel];
+    if (!(sources & (1UL << owner))) {
+      owner = fallback;
+      _owner[channel] = owner;
+    }
+    out[channel] = _inputs[owner][channel];
+  }
+}
+
+void WirelessDMXMerger::_publish()
+{
+  uint32_t generation = _frameGeneration.load(std::memory_order_relaxed) + 1;
+
+  _frontBuffer.store(_frames[_backIndex], std::memory_order_release);
+  _frameGeneration.store(generation, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_release);
+  _backIndex = (_backIndex + 1) % 3;
+}
+
+void WirelessDMXMerger::_startMergeThread(void* _this)
+{
+  ((WirelessDMXMerger*)_this)->_mergeLoop();
+}
+
+void WirelessDMXMerger::_mergeLoop()
+{
+  while (!_stopRequested) {
+    // Woken by any of the sources as soon as it published a frame, and regularly to notice sources that stopped
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WDMX_MERGE_POLL_MS));
+
+    uint32_t sources = 0;
+    uint32_t updated = 0;
+    for (unsigned int i = 0; i < _count; i++) {
+      if (_sources[i]->readSnapshot(_inputs[i], DMX_BUFSIZE, &_generations[i])) {
+        updated |= (1UL << i);
+      }
+      if (_alive(i)) {
+        sources |= (1UL << i);
+      }
+    }
+
+    int active = (sources != 0) ? __builtin_ctz(sources) : -1;
+    if (active != _activeSource) {
+      _activeSource = active;
+      _failovers = _failovers + 1;
+    }
+    // Sources that dropped out or came back change the result even without new frames. In failover mode, this
+    // publishes the backup's latest frame right away, instead of waiting for its next one.
+    bool changed = (sources != _mergedSources);
+    _mergedSources = sources;
+    if (sources == 0) {
+      continue; // Hold the last frame
+    }
+    if (!changed && ((updated & sources) == 0)) {
+      continue; // Nothing new from any source that takes part
+    }
+
+    uint8_t* out = _frames[_backIndex];
+    if (_policy == WDMX_MERGE_HTP) {
+      _mergeHTP((uint32_t*)out, sources);
+    } else if (_policy == WDMX_MERGE_LTP) {
+      _mergeLTP(out, sources, updated);
+    } else {
+      if (!changed && !(updated & (1UL << active))) {
+        continue; // Only a backup has a new frame
+      }
+      memcpy(out, _inputs[active], DMX_BUFSIZE);
+    }
+    _publish();
+  }
+
+  _taskRunning = false;   // _stopTask() returns once this is cleared; don't touch any members after this
+  vTaskDelete(nullptr);
+}
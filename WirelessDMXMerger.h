@@ -0,0 +1,101 @@
+/*
+  WirelessDMXMerger.h - Merge the universes of several receivers (HTP, LTP or primary/backup)
+  Released into the public domain.
+*/
+
+#ifndef WirelessDMXMerger_h
+#define WirelessDMXMerger_h
+
+#include "Arduino.h"
+#include <atomic>
+#include "WirelessDMXReceiver.h"
+
+#define WDMX_MERGE_MAX_SOURCES          4   // Maximum number of receivers merged by one merger
+#define WDMX_MERGE_TIMEOUT_MS          20   // A source without packets for this long is dropped from the merge. Must exceed
+                                            // the housekeeping interval that updates lastPacketMillis().
+#define WDMX_MERGE_POLL_MS              5   // Interval at which the merge task checks for sources that stopped
+#define WDMX_MERGE_TASK_PRIORITY        9   // Just below the receive task
+#define WDMX_MERGE_TASK_STACK_SIZE   2048   // In bytes
+
+enum wdmxMergePolicy_t {                    // How WirelessDMXMerger combines its sources
+  WDMX_MERGE_HTP = 0,                       // Highest takes precedence: every channel is the maximum over all sources
+  WDMX_MERGE_LTP = 1,                       // Latest takes precedence: every channel follows the source that changed it last
+  WDMX_MERGE_FAILOVER = 2                   // Use the first source that receives; the others are backups, in order
+};
+
+/*
+ * Combines the universes of several WirelessDMXReceivers - e.g. two transmitters with the same show for
+ * redundancy, or two desks sharing control - into one.
+ *
+ * The merge task wakes up whenever any source publishes a frame, picks up the new frames and computes the merged
+ * frame, which is published the same way as the receiver's triple buffer: getFrame() and getValue() always see a
+ * complete frame, readSnapshot() copies one consistently.
+ *
+ * Sources that are unlocked, or haven't received a packet for WDMX_MERGE_TIMEOUT_MS, don't take part. The merged
+ * frame is recomputed as soon as the set of sources changes, from the frames already received. Counting the
+ * granularity of lastPacketMillis() (WDMX_HOUSEKEEPING_MS) and WDMX_MERGE_POLL_MS, the merger switches to the
+ * backup at most 35ms after the last packet of the primary in failover mode, about one frame period of a full
+ * universe.
+ */
+class WirelessDMXMerger
+{
+  public:
+    WirelessDMXMerger(wdmxMergePolicy_t policy);
+    ~WirelessDMXMerger();
+
+    /*
+     * Add a source. In WDMX_MERGE_FAILOVER mode, sources are prioritized in the order they are added. Must be
+     * called before begin(), and before the receiver's begin(). Returns false if the merger is full.
+     */
+    bool add(WirelessDMXReceiver& receiver);
+
+    /*
+     * Start the merge task. Returns false, with nothing left running, if a source has no room for another frame
+     * callback.
+     */
+    bool begin(BaseType_t core = WDMX_TASK_CORE, UBaseType_t priority = WDMX_MERGE_TASK_PRIORITY);
+
+    uint8_t getValue(unsigned int address) const { return (getFrame()[address-1]); };
+    const uint8_t* getFrame() const { return (_frontBuffer.load(std::memory_order_acquire)); };
+    uint32_t frameGeneration() const { return (_frameGeneration.load(std::memory_order_acquire)); };
+    bool readSnapshot(uint8_t* dst, size_t len, uint32_t* gen = nullptr) const;
+
+    /*
+     * Index (in the order of add()) of the source the output currently follows in WDMX_MERGE_FAILOVER mode, or -1
+     * if no source receives.
+     */
+    int activeSource() const { return (_activeSource); };
+    uint32_t failovers() const { return (_failovers); };    // Number of times the active source changed
+
+  private:
+    bool _alive(unsigned int source) const;
+    void _mergeHTP(uint32_t* out, uint32_t sources);
+    void _mergeLTP(uint8_t* out, uint32_t sources, uint32_t updated);
+    void _publish();
+    void _mergeLoop();
+    static void _startMergeThread(void*);
+    void _removeCallbacks();
+    void _stopTask();
+
+    wdmxMergePolicy_t _policy;
+    WirelessDMXReceiver* _sources[WDMX_MERGE_MAX_SOURCES];
+    int _callbacks[WDMX_MERGE_MAX_SOURCES];             // Index of our frame callback on each source, -1 if none
+    unsigned int _count = 0;
+    uint32_t _generations[WDMX_MERGE_MAX_SOURCES] = {};   // frameGeneration() of the frame in _inputs
+    alignas(4) uint8_t _inputs[WDMX_MERGE_MAX_SOURCES][DMX_BUFSIZE];
+    alignas(4) uint8_t _previous[WDMX_MERGE_MAX_SOURCES][DMX_BUFSIZE];  // In LTP mode, the source's frame before that
+    uint8_t _owner[DMX_BUFSIZE];                        // In LTP mode, the source that changed each channel last
+    uint32_t _mergedSources = 0;                        // Bitmap of the sources the last merged frame was built from
+    volatile int _activeSource = -1;
+    volatile uint32_t _failovers = 0;
+    TaskHandle_t _mergeTask = nullptr;
+    volatile bool _taskRunning = false;
+    volatile bool _stopRequested = false;               // Asks the merge task to exit, see _stopTask()
+
+    alignas(4) uint8_t _frames[3][DMX_BUFSIZE];
+    unsigned int _backIndex = 0;
+    std::atomic<const uint8_t*> _frontBuffer;
+    std::atomic<uint32_t> _frameGeneration{0};
+};
+
+#endif
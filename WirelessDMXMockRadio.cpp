@@ -0,0 +1,154 @@
+/*
+  WirelessDMXMockRadio.cpp - Simulated radio for the WirelessDMXReceiver library
+  Released into the public domain.
+*/
+
+#include "WirelessDMXMockRadio.h"
+
+WirelessDMXMockRadio::WirelessDMXMockRadio(unsigned int channel, wdmxID_t ID)
+{
+  memset(_universe, 0x00, sizeof(_universe));
+  setTransmitter(channel, ID);
+  _nextPacketTime = micros();
+}
+
+void WirelessDMXMockRadio::setTransmitter(unsigned int channel, wdmxID_t ID)
+{
+  _txChannel = channel;
+  _txAddress = WirelessDMXReceiver::getAddress(channel, ID);
+}
+
+void WirelessDMXMockRadio::setUniverse(const uint8_t* data, unsigned int channelCount)
+{
+  _channelCount = constrain(channelCount, 1U, (unsigned int)DMX_BUFSIZE);
+  memcpy(_universe, data, _channelCount);
+}
+
+void WirelessDMXMockRadio::replay(const WirelessDMXReceiver::wdmxCaptureRecord* records, size_t count)
+{
+  _replay = records;
+  _replayCount = (records != nullptr) ? count : 0;
+  _position = 0;
+}
+
+void WirelessDMXMockRadio::openReadingPipe(uint8_t pipe, uint64_t address)
+{
+  if (pipe < 2) {
+    _pipeAddress[pipe] = address;
+    _pipeOpen[pipe] = true;
+  }
+}
+
+void WirelessDMXMockRadio::closeReadingPipe(uint8_t pipe)
+{
+  if (pipe < 2) {
+    _pipeOpen[pipe] = false;
+  }
+}
+
+void WirelessDMXMockRadio::startListening()
+{
+  _update();
+  _listening = true;
+}
+
+bool WirelessDMXMockRadio::available(uint8_t* pipe)
+{
+  _update();
+  if (_fifoCount == 0) {
+    return(false);
+  }
+  if (pipe != nullptr) {
+    *pipe = _fifoPipe[0];
+  }
+  return(true);
+}
+
+void WirelessDMXMockRadio::read(void* buf, uint8_t len)
+{
+  if (_fifoCount == 0) {
+    memset(buf, 0x00, len);
+    return;
+  }
+  memcpy(buf, &_fifo[0], min((size_t)len, sizeof(_fifo[0])));
+  _fifoCount--;
+  memmove(&_fifo[0], &_fifo[1], _fifoCount * sizeof(_fifo[0]));
+  memmove(&_fifoPipe[0], &_fifoPipe[1], _fifoCount);
+}
+
+/*
+ * Pipe that would accept a packet from the transmitter right now, or -1.
+ */
+int WirelessDMXMockRadio::_matchingPipe()
+{
+  if (!_enabled || !_listening || (_channel != _txChannel)) {
+    return(-1);
+  }
+  for (int pipe = 0; pipe < 2; pipe++) {
+    if (_pipeOpen[pipe] && (((_pipeAddress[pipe] ^ _txAddress) & WDMX_ADDRESS_MASK) == 0)) {
+      return(pipe);
+    }
+  }
+  return(-1);
+}
+
+/*
+ * Put every packet that went on air since the last call into the RX FIFO, if it's for us.
+ */
+void WirelessDMXMockRadio::_update()
+{
+  unsigned long now = micros();
+  int pipe = _matchingPipe();
+
+  while ((long)(now - _nextPacketTime) >= 0) {
+    // If nobody can receive the next packets, skip ahead instead of generating each of them
+    if ((pipe < 0) || (_fifoCount == WDMX_RX_FIFO_DEPTH)) {
+      unsigned long skipped = (now - _nextPacketTime) / _interval + 1;
+      _position += skipped;
+      _nextPacketTime += skipped * _interval;
+      if (_enabled) {
+        _packetsSent += skipped;
+        if (pipe >= 0) {
+          _packetsDropped += skipped;
+        }
+      }
+      break;
+    }
+
+    _random = _random * 1103515245 + 12345;
+    if ((_lossPermille > 0) && ((_random >> 16) % 1000 < _lossPermille)) {
+      _position++;
+      _packetsDropped++;
+    } else {
+      _nextPacket(_fifo[_fifoCount]);
+      _fifoPipe[_fifoCount] = pipe;
+      _fifoCount++;
+      _packetsReceived++;
+    }
+    _packetsSent++;
+    _nextPacketTime += _interval;
+  }
+}
+
+/*
+ * Build the packet at _position, and advance _position.
+ */
+void WirelessDMXMockRadio::_nextPacket(WirelessDMXReceiver::wdmxReceiveBuffer& packet)
+{
+  if (_replayCount > 0) {
+    packet = _replay[_position % _replayCount].packet;
+    _position++;
+    return;
+  }
+
+  unsigned int numPayloads = (_channelCount - 1) / sizeof(packet.dmxData) + 1;
+  unsigned int payloadID = _position % numPayloads;
+  unsigned int start = payloadID * sizeof(packet.dmxData);
+
+  packet.magic = (_position % 14 == 0) ? WDMX_MAGIC_2 : WDMX_MAGIC_1;
+  packet.payloadID = payloadID;
+  packet.highestChannelID = _channelCount - 1;
+  memset(packet.dmxData, 0x00, sizeof(packet.dmxData));
+  memcpy(packet.dmxData, &_universe[start], min(sizeof(packet.dmxData), (size_t)(_channelCount - start)));
+  _position++;
+}
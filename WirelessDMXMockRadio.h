@@ -0,0 +1,100 @@
+/*
+  WirelessDMXMockRadio.h - Simulated radio for the WirelessDMXReceiver library
+  Released into the public domain.
+*/
+
+#ifndef WirelessDMXMockRadio_h
+#define WirelessDMXMockRadio_h
+
+#include "Arduino.h"
+#include "WirelessDMXRadio.h"
+#include "WirelessDMXReceiver.h"
+
+#define WDMX_PACKET_INTERVAL_US      1852   // A real transmitter sends 540 packets per second
+#define WDMX_ADDRESS_MASK   0xFFFFFFFFFFULL   // Pipe addresses are 5 bytes wide
+
+/*
+ * A WirelessDMXRadio that simulates a single Wireless DMX transmitter, for benchmarking and testing the
+ * receiver without RF hardware.
+ *
+ * The transmitter sits on a given channel and unit ID, and sends packets at the rate of a real transmitter (or
+ * faster, see setSpeedup()) whether or not anybody listens. Packets only end up in the simulated 3-deep RX FIFO
+ * while the receiver listens on the right channel with a matching pipe address, so scanning behaves like it does
+ * on air. If the FIFO is full, packets are dropped just like on the nRF24L01.
+ *
+ * Packets are either generated from a universe set by setUniverse()/setValue(), or replayed from a capture.
+ * Use the radio from one task only; the transmitter settings may be changed from any task.
+ *
+ * The mock replaces the radio only. With the shims in test/host, it also runs on the host, like the rest of the library.
+ */
+class WirelessDMXMockRadio : public WirelessDMXRadio
+{
+  public:
+    WirelessDMXMockRadio(unsigned int channel, wdmxID_t ID);
+
+    void setTransmitter(unsigned int channel, wdmxID_t ID);
+    void setTransmitterEnabled(bool enabled) { _enabled = enabled; }; // Simulate power-cycling the transmitter
+    void setSpeedup(unsigned int factor) { _interval = WDMX_PACKET_INTERVAL_US / max(factor, 1U); };
+    void setPacketLoss(unsigned int permille) { _lossPermille = permille; };   // Randomly lose packets on air
+
+    void setUniverse(const uint8_t* data, unsigned int channelCount);
+    void setValue(unsigned int address, uint8_t value) { _universe[address-1] = value; };
+
+    // Send the captured packets in a loop, at the packet rate of a real transmitter, instead of the universe.
+    // The records must stay valid while replaying; replay(nullptr, 0) switches back to the universe.
+    void replay(const WirelessDMXReceiver::wdmxCaptureRecord* records, size_t count);
+
+    uint32_t packetsSent() const { return (_packetsSent); };       // Packets the transmitter sent
+    uint32_t packetsReceived() const { return (_packetsReceived); }; // Packets that made it into the RX FIFO
+    uint32_t packetsDropped() const { return (_packetsDropped); };   // Packets lost on air or because the FIFO was full
+
+    bool begin() override { return (true); };
+
+    void flush_rx() override { _fifoCount = 0; };
+    void openReadingPipe(uint8_t pipe, uint64_t address) override;
+    void closeReadingPipe(uint8_t pipe) override;
+    void startListening() override;
+    void setChannel(uint8_t channel) override { _update(); _channel = channel; };
+    uint8_t getChannel() override { return (_channel); };
+
+    bool available() override { return (available(nullptr)); };
+    bool available(uint8_t* pipe) override;
+    void read(void* buf, uint8_t len) override;
+    bool rxFifoFull() override { _update(); return (_fifoCount == WDMX_RX_FIFO_DEPTH); };
+    bool testRPD() override { return (_enabled && _listening && (_channel == _txChannel)); };
+    void maskIRQ(bool tx_ok, bool tx_fail, bool rx_ready) override {};
+
+  private:
+    void _update();
+    void _nextPacket(WirelessDMXReceiver::wdmxReceiveBuffer& packet);
+    int _matchingPipe();
+
+    // Transmitter
+    volatile bool _enabled = true;
+    unsigned int _txChannel;
+    uint64_t _txAddress;
+    uint8_t _universe[DMX_BUFSIZE];
+    unsigned int _channelCount = DMX_BUFSIZE;
+    const WirelessDMXReceiver::wdmxCaptureRecord* _replay = nullptr;
+    size_t _replayCount = 0;
+    uint32_t _position = 0;             // Packets sent so far, determines the next payload
+    unsigned long _nextPacketTime;      // micros() when the next packet goes on air
+    unsigned long _interval = WDMX_PACKET_INTERVAL_US;
+    unsigned int _lossPermille = 0;
+    uint32_t _random = 1;
+
+    // Receiver
+    uint8_t _channel = 0;
+    bool _listening = false;
+    bool _pipeOpen[2] = { false, false };
+    uint64_t _pipeAddress[2];
+    WirelessDMXReceiver::wdmxReceiveBuffer _fifo[WDMX_RX_FIFO_DEPTH];
+    uint8_t _fifoPipe[WDMX_RX_FIFO_DEPTH];
+    unsigned int _fifoCount = 0;
+
+    uint32_t _packetsSent = 0;
+    uint32_t _packetsReceived = 0;
+    uint32_t _packetsDropped = 0;
+};
+
+#endif
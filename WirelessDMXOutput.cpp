@@ -0,0 +1,117 @@
+/*
+  WirelessDMXOutput.cpp - Re-transmit a received universe on a wired DMX512 line
+  Released into the public domain.
+*/
+
+#include "WirelessDMXOutput.h"
+
+WirelessDMXOutput::WirelessDMXOutput(WirelessDMXReceiver& receiver, uart_port_t port, int txPin, int dePin)
+  : _receiver(receiver)
+{
+  _port = port;
+  _txPin = txPin;
+  _dePin = dePin;
+}
+
+WirelessDMXOutput::~WirelessDMXOutput()
+{
+  if (!_taskRunning) {
+    return;
+  }
+  // Make sure that the receiver doesn't notify the task after it is gone
+  _receiver.removeFrameCallback(_frameCallback);
+  _stopTask();
+  uart_driver_delete(_port);
+}
+
+/*
+ * Let the output task finish the frame it is sending and exit.
+ */
+void WirelessDMXOutput::_stopTask()
+{
+  _stopRequested = true;
+  xTaskNotifyGive(_outputTask);
+  while (_taskRunning) {
+    delay(1);
+  }
+  _outputTask = nullptr;
+}
+
+bool WirelessDMXOutput::begin(BaseType_t core, UBaseType_t priority)
+{
+  uart_config_t config = {};
+
+  config.baud_rate = WDMX_OUTPUT_BAUDRATE;
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = UART_PARITY_DISABLE;
+  config.stop_bits = UART_STOP_BITS_2;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  config.source_clk = UART_SCLK_DEFAULT;
+
+  // The driver requires an RX buffer larger than the hardware FIFO even though we never receive. No TX buffer, so
+  // that uart_write_bytes() feeds the FIFO directly from the front buffer.
+  if (uart_driver_install(_port, 256, 0, 0, nullptr, 0) != ESP_OK) {
+    return(false);
+  }
+  if ((uart_param_config(_port, &config) != ESP_OK) ||
+      (uart_set_pin(_port, _txPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK)) {
+    uart_driver_delete(_port);
+    return(false);
+  }
+  // The idle time after the break is the mark after break
+  uart_set_tx_idle_num(_port, WDMX_OUTPUT_MAB_BITS);
+
+  if (_dePin >= 0) {
+    pinMode(_dePin, OUTPUT);
+    digitalWrite(_dePin, HIGH);
+  }
+
+  _stopRequested = false;
+  _taskRunning = true;
+  xTaskCreatePinnedToCore(
+    _startOutputThread,           /* Function to implement the task */
+    "DMX Output Thread",          /* Name of the task */
+    WDMX_OUTPUT_TASK_STACK_SIZE,  /* Stack size in bytes */
+    this,                         /* Task input parameter */
+    priority,                     /* Priority of the task */
+    &_outputTask,                 /* Task handle. */
+    core                          /* Core where the task should run */
+  );
+
+  TaskHandle_t outputTask = _outputTask;
+  _frameCallback = _receiver.addFrameCallback([outputTask]() { xTaskNotifyGive(outputTask); });
+  if (_frameCallback < 0) {
+    _stopTask();
+    uart_driver_delete(_port);
+    return(false);
+  }
+  return(true);
+}
+
+void WirelessDMXOutput::_startOutputThread(void* _this)
+{
+  ((WirelessDMXOutput*)_this)->_outputLoop();
+}
+
+void WirelessDMXOutput::_outputLoop()
+{
+  const uint8_t startCode = 0;
+
+  // Every frame is followed by the break of the next one. Precede the first frame with a break too; receivers
+  // ignore the stray byte before it.
+  uart_write_bytes_with_break(_port, &startCode, 1, WDMX_OUTPUT_BREAK_BITS);
+  while (!_stopRequested) {
+    // Wait for the next frame, or re-send the last one so that fixtures don't consider the line dead
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WDMX_OUTPUT_KEEPALIVE_MS));
+
+    unsigned int channelCount = max(_receiver.getChannelCount(), (unsigned int)WDMX_OUTPUT_MIN_SLOTS);
+
+    uart_write_bytes(_port, &startCode, 1);
+    uart_write_bytes_with_break(_port, _receiver.getFrame(), channelCount, WDMX_OUTPUT_BREAK_BITS);
+    _framesSent = _framesSent + 1;
+  }
+
+  uart_wait_tx_done(_port, pdMS_TO_TICKS(WDMX_OUTPUT_KEEPALIVE_MS));
+  _taskRunning = false;   // _stopTask() returns once this is cleared; don't touch any members after this
+  vTaskDelete(nullptr);
+}
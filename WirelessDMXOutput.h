@@ -0,0 +1,67 @@
+/*
+  WirelessDMXOutput.h - Re-transmit a received universe on a wired DMX512 line
+  Released into the public domain.
+*/
+
+#ifndef WirelessDMXOutput_h
+#define WirelessDMXOutput_h
+
+#include "Arduino.h"
+#include <driver/uart.h>
+#include "WirelessDMXReceiver.h"
+
+#define WDMX_OUTPUT_BAUDRATE       250000   // DMX512 line rate, 8N2
+#define WDMX_OUTPUT_BREAK_BITS         25   // Break length in bit times (4us each): 100us, the minimum is 88us
+#define WDMX_OUTPUT_MAB_BITS            3   // Mark after break in bit times: 12us, the minimum is 8us
+#define WDMX_OUTPUT_MIN_SLOTS          24   // Send at least this many channels, to keep the frame above the 1204us minimum
+#define WDMX_OUTPUT_KEEPALIVE_MS      100   // Re-send the last frame this often if no new one is published
+#define WDMX_OUTPUT_TASK_PRIORITY       9   // Just below the receive task
+#define WDMX_OUTPUT_TASK_STACK_SIZE  2048   // In bytes
+
+/*
+ * Sends the universe received by a WirelessDMXReceiver on a UART, for an RS-485 transceiver.
+ *
+ * Every published frame wakes the output task, which writes the start code and the front buffer straight into
+ * the UART TX FIFO (the driver is installed without a TX ring buffer, so there is no intermediate copy), followed
+ * by the break that precedes the next frame. Only the channels of the received universe are sent (see
+ * getChannelCount()), which shortens the frame and raises the refresh rate for small universes.
+ *
+ * Use WDMX_BUFFER_TRIPLE mode: the front buffer then stays intact for at least one more frame, which is longer
+ * than the 22.7ms a full universe takes on the wire. In direct mode, the output may mix two frames.
+ *
+ * If dePin is given, it is driven high to enable the transceiver's driver.
+ */
+class WirelessDMXOutput
+{
+  public:
+    WirelessDMXOutput(WirelessDMXReceiver& receiver, uart_port_t port, int txPin, int dePin = -1);
+    ~WirelessDMXOutput();
+
+    /*
+     * Install the UART driver and start the output task. Must be called before receiver.begin(), as it registers
+     * a frame callback. Returns false, with nothing left running, if that fails.
+     *
+     * By default, the task may run on either core. Don't pin it to the core of a receive task that polls (has no
+     * IRQ pin): that task only yields one tick every WDMX_POLL_YIELD_MS, which would delay the output by as much.
+     */
+    bool begin(BaseType_t core = tskNO_AFFINITY, UBaseType_t priority = WDMX_OUTPUT_TASK_PRIORITY);
+
+    uint32_t framesSent() const { return(_framesSent); };
+
+  private:
+    void _outputLoop();
+    static void _startOutputThread(void*);
+    void _stopTask();
+
+    WirelessDMXReceiver& _receiver;
+    uart_port_t _port;
+    int _txPin;
+    int _dePin;
+    TaskHandle_t _outputTask = nullptr;
+    int _frameCallback = -1;               // Index of our frame callback on the receiver
+    volatile bool _taskRunning = false;
+    volatile bool _stopRequested = false;  // Asks the output task to exit, see _stopTask()
+    volatile uint32_t _framesSent = 0;
+};
+
+#endif
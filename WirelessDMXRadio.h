@@ -0,0 +1,96 @@
+/*
+  WirelessDMXRadio.h - Radio abstraction for the WirelessDMXReceiver library
+  Released into the public domain.
+*/
+
+#ifndef WirelessDMXRadio_h
+#define WirelessDMXRadio_h
+
+#include "Arduino.h"
+#include <nRF24L01.h>
+#include <RF24.h>
+#include <SPI.h>
+
+#define WDMX_SPI_SPEED           10000000   // SPI clock for the nRF24L01. 10MHz is the maximum the chip supports.
+
+/*
+ * The subset of the RF24 interface that WirelessDMXReceiver uses. Method names follow RF24, so that the
+ * nRF24L01 datasheet and the RF24 documentation apply.
+ *
+ * WirelessDMXRF24Radio implements this on real hardware; WirelessDMXMockRadio simulates a transmitter for
+ * benchmarking and testing without RF hardware.
+ */
+class WirelessDMXRadio
+{
+  public:
+    virtual ~WirelessDMXRadio() {};
+
+    virtual bool begin() = 0;   // Start the radio and configure it for the Wireless DMX protocol
+    virtual void printPrettyDetails() {};
+
+    virtual void flush_rx() = 0;
+    virtual void openReadingPipe(uint8_t pipe, uint64_t address) = 0;
+    virtual void closeReadingPipe(uint8_t pipe) = 0;
+    virtual void startListening() = 0;
+    virtual void setChannel(uint8_t channel) = 0;
+    virtual uint8_t getChannel() = 0;
+
+    virtual bool available() = 0;
+    virtual bool available(uint8_t* pipe) = 0;
+    virtual void read(void* buf, uint8_t len) = 0;
+    virtual bool rxFifoFull() = 0;
+
+    /*
+     * The receive path's combined versions of the above, which implementations may do with fewer SPI transactions:
+     * rxFifoStatus() is available() that also sets full to rxFifoFull(), and readPayload() is read() that returns
+     * whether another payload is waiting.
+     */
+    virtual bool rxFifoStatus(bool& full) { full = false; if (!available()) { return (false); } full = rxFifoFull(); return (true); };
+    virtual bool readPayload(void* buf, uint8_t len) { read(buf, len); return (available()); };
+    virtual bool testRPD() = 0;
+    virtual void maskIRQ(bool tx_ok, bool tx_fail, bool rx_ready) = 0;
+};
+
+/*
+ * WirelessDMXRadio backed by an nRF24L01 through the RF24 library.
+ *
+ * Configuration goes through RF24. The calls on the receive path - available(), read(), rxFifoStatus() and
+ * readPayload() - talk to the chip directly instead: each is a single SPI transaction without RF24's per-command
+ * overhead (a settling delay after every CSN edge, and separate transactions for the payload and for clearing
+ * RX_DR).
+ *
+ * spiBus selects the SPI bus (e.g. an SPIClass(HSPI) started by the application); nullptr uses the default SPI.
+ */
+class WirelessDMXRF24Radio final : public WirelessDMXRadio
+{
+  public:
+    WirelessDMXRF24Radio(int cePin, int csnPin, uint32_t spiSpeed = WDMX_SPI_SPEED, SPIClass* spiBus = nullptr)
+      : _radio(cePin, csnPin, spiSpeed), _csnPin(csnPin), _spiSettings(spiSpeed, MSBFIRST, SPI_MODE0), _spi(spiBus) {};
+
+    bool begin() override;
+    void printPrettyDetails() override { _radio.printPrettyDetails(); };
+
+    void flush_rx() override { _radio.flush_rx(); };
+    void openReadingPipe(uint8_t pipe, uint64_t address) override { _radio.openReadingPipe(pipe, address); };
+    void closeReadingPipe(uint8_t pipe) override { _radio.closeReadingPipe(pipe); };
+    void startListening() override { _radio.startListening(); };
+    void setChannel(uint8_t channel) override { _radio.setChannel(channel); };
+    uint8_t getChannel() override { return (_radio.getChannel()); };
+
+    bool available() override { return (available(nullptr)); };
+    bool available(uint8_t* pipe) override;
+    void read(void* buf, uint8_t len) override { readPayload(buf, len); };
+    bool rxFifoFull() override { return (_radio.rxFifoFull()); };
+    bool rxFifoStatus(bool& full) override;
+    bool readPayload(void* buf, uint8_t len) override;
+    bool testRPD() override { return (_radio.testRPD()); };
+    void maskIRQ(bool tx_ok, bool tx_fail, bool rx_ready) override { _radio.maskIRQ(tx_ok, tx_fail, rx_ready); };
+
+  private:
+    RF24 _radio;
+    int _csnPin;
+    SPISettings _spiSettings;
+    SPIClass* _spi;
+};
+
+#endif
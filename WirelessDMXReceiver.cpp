@@ -6,6 +6,9 @@
 
 #include "WirelessDMXReceiver.h"
 #include <esp_task_wdt.h>
+#include <esp_timer.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
 
 /*
  * Helper function to convert a (Unit ID, Channel ID) tuple into the
@@ -15,7 +18,7 @@
  * for a description of these values.
  *
  */
-inline uint64_t WirelessDMXReceiver::_getAddress(unsigned int channel, wdmxID_t ID)
+uint64_t WirelessDMXReceiver::getAddress(unsigned int channel, wdmxID_t ID)
 {
   union wdmxAddress {
     struct {
@@ -28,6 +31,7 @@ inline uint64_t WirelessDMXReceiver::_getAddress(unsigned int channel, wdmxID_t
     uint64_t uint64;
   } address;
 
+  address.uint64 = 0; // RF24 only uses the lower 5 bytes, but keep the rest well-defined for comparisons
   address.structured.channel = channel;
   address.structured.ID = ID;
   address.structured.notChannel = ~channel;
@@ -41,125 +45,920 @@ inline uint64_t WirelessDMXReceiver::_getAddress(unsigned int channel, wdmxID_t
  * Given a unit ID and a channel, probe a single channel.
  *
  * Waits up to 10ms for data, and returns false if we encountered a timeout or read anything other than DMX data.
- * Return true if we did read DMX data.
+ * In WDMX_SCAN_FAST mode, gives up after 1ms already if there is no carrier on the channel.
+ * Return true if we did read DMX data. In that case, _ID holds the unit ID of the transmitter we found.
  */
 bool WirelessDMXReceiver::_scanChannel()
 {
-  wdmxReceiveBuffer rxBuf;
+  int result;
 
-  if ((_statusLEDPin != 0) && (_channel % 16 == 0)) {
-    digitalWrite(_statusLEDPin, !digitalRead(_statusLEDPin)); // Blink status LED while scanning - this will flash quickly
+  _startProbe();
+  while ((result = _pollProbe()) == 0) {
   }
+  return(result > 0);
+}
+
+/*
+ * Start listening for a transmitter with unit ID _ID on channel _channel. Use _pollProbe() to find out whether
+ * we found one.
+ *
+ * In AUTO mode, pipe 1 listens for the next unit ID at the same time (see _pairedID()). Pipes 2..5 can't be used
+ * for this purpose: they share the upper four address bytes with pipe 1, and only the lowest address byte - which
+ * holds the channel and is therefore the same for all unit IDs - can be set per pipe.
+ */
+void WirelessDMXReceiver::_startProbe()
+{
+  wdmxID_t pairedID = _pairedID();
 
-  _radio.flush_rx();
-  _radio.openReadingPipe(0, _getAddress(_channel, _ID));
-  _radio.startListening();
-  _radio.setChannel(_channel);
+  _radio->flush_rx();
+  _radio->openReadingPipe(0, getAddress(_channel, _ID));
+  if (pairedID != AUTO) {
+    _radio->openReadingPipe(1, getAddress(_channel, pairedID));
+  } else {
+    _radio->closeReadingPipe(1);
+  }
+  _radio->startListening();
+  _radio->setChannel(_channel);
   if (debug) {
-    Serial.printf("SCAN: Channel %d (%d), unit ID %d, address %llx\n", _radio.getChannel(), _channel, _ID, _getAddress(_channel, _ID));
+    Serial.printf("SCAN: Channel %d (%d), unit ID %d, address %llx\n", _radio->getChannel(), _channel, _ID, (unsigned long long)getAddress(_channel, _ID));
+    if (pairedID != AUTO) {
+      Serial.printf("SCAN: Channel %d (%d), unit ID %d, address %llx\n", _radio->getChannel(), _channel, pairedID, (unsigned long long)getAddress(_channel, pairedID));
+    }
   }
 
-  unsigned long started_waiting_at = micros(); // timeout setup
-  while (!_radio.available()) {                   // While nothing is received
-    if (micros() - started_waiting_at > 10000) {  // If waited longer than 10ms, indicate timeout and exit while loop
-       return(false);
+  _probing = true;
+  _probeCarrier = false;
+  _probeStarted = micros(); // timeout setup
+}
+
+/*
+ * Check on the probe started by _startProbe(), without blocking.
+ *
+ * Returns 0 while the probe is still running, 1 if we found a transmitter, and -1 if there is none.
+ */
+int WirelessDMXReceiver::_pollProbe()
+{
+  wdmxReceiveBuffer rxBuf;
+  wdmxID_t pairedID = _pairedID();
+  unsigned long waited = micros() - _probeStarted;
+  uint8_t pipe;
+
+  if (!_radio->available(&pipe)) {                        // Nothing received yet
+    if ((_scanMode == WDMX_SCAN_FAST) && !_probeCarrier) {
+      // RPD is a snapshot of the current power level, so keep sampling it for longer than the gap between packets
+      _probeCarrier = _radio->testRPD();
+      if (!_probeCarrier && (waited > WDMX_SCAN_CARRIER_US)) {
+        _probing = false;
+        return(-1);
+      }
     }
+    if (waited > WDMX_SCAN_TIMEOUT_US) {                  // If waited longer than 10ms, indicate timeout
+      _probing = false;
+      return(-1);
+    }
+    return(0);
   }
 
-  _radio.read(&rxBuf, sizeof(rxBuf));
+  _probing = false;
+  _radio->read(&rxBuf, sizeof(rxBuf));
   if ((rxBuf.magic == WDMX_MAGIC_1) || (rxBuf.magic == WDMX_MAGIC_2)) {
+    // Stop listening on the pipe that didn't match, so that we only receive from the transmitter we found.
+    if (pipe == 1) {
+      _ID = pairedID;
+      _radio->closeReadingPipe(0);
+    } else {
+      _radio->closeReadingPipe(1);
+    }
     if (debug) {
       Serial.printf("SCAN: Found a transmitter on channel %d, unit ID %d\n", _channel, _ID);
     }
-    return(true);
+    return(1);
   }
 
   // If we got here, we found *something* but it wasn't valid Wireless DMX data
-  Serial.printf("SCAN: Found invalid data on channel %d, unit ID %d\n", _channel, _ID);
+  Serial.printf("SCAN: Found invalid data on channel %d, unit ID %d\n", _channel, (pipe == 1) ? pairedID : _ID);
+  return(-1);
+}
+
+/*
+ * Unit ID to probe on pipe 1 alongside _ID, or AUTO if none.
+ *
+ * In AUTO mode, the scan walks through the unit IDs in pairs (RED+GREEN, YELLOW+BLUE, MANGENTA+CYAN, WHITE).
+ */
+wdmxID_t WirelessDMXReceiver::_pairedID()
+{
+  if ((_configID != AUTO) || (_ID >= WHITE)) {
+    return(AUTO);
+  }
+  return((wdmxID_t)(_ID + 1));
+}
+
+/*
+ * Probe the channel and unit ID persisted by _saveLastLock(), if any.
+ *
+ * Returns true and leaves _channel/_ID set if we found a transmitter there. Otherwise, leaves _channel/_ID
+ * untouched so that the regular scan starts where it would have started anyway.
+ */
+bool WirelessDMXReceiver::_probeLastLock()
+{
+  unsigned int savedChannel;
+  wdmxID_t savedID;
+
+  if (!_loadLastLock(savedChannel, savedID)) {
+    return(false);
+  }
+
+  unsigned int channel = _channel;
+  wdmxID_t ID = _ID;
+  _channel = savedChannel;
+  _ID = savedID;
+  for (unsigned int i = 0; i < WDMX_LOCK_PROBE_RETRIES; i++) {
+    if (_scanChannel()) {
+      return(true);
+    }
+  }
+
+  if (debug) {
+    Serial.printf("SCAN: No transmitter on last known channel %d, unit ID %d\n", savedChannel, savedID);
+  }
+  _channel = channel;
+  _ID = ID;
   return(false);
 }
 
+/*
+ * Read the channel and unit ID persisted by _saveLastLock(). Returns false if there is none, or if it does not
+ * match the configured unit ID.
+ */
+bool WirelessDMXReceiver::_loadLastLock(unsigned int& channel, wdmxID_t& ID)
+{
+  Preferences prefs;
+
+  if (!prefs.begin(_nvsNamespace, true)) {
+    return(false); // Namespace does not exist yet
+  }
+  channel = prefs.getUChar("channel", 0xFF);
+  ID = (wdmxID_t)prefs.getUChar("id", AUTO);
+  prefs.end();
+
+  return((channel <= 126) && (ID != AUTO) && (ID <= WHITE) && ((_configID == AUTO) || (ID == _configID)));
+}
+
+/*
+ * Persist the current channel and unit ID. Only writes to flash if they changed.
+ */
+void WirelessDMXReceiver::_saveLastLock()
+{
+  Preferences prefs;
+
+  if (!prefs.begin(_nvsNamespace, false)) {
+    return;
+  }
+  if (prefs.getUChar("channel", 0xFF) != _channel) {
+    prefs.putUChar("channel", _channel);
+  }
+  if (prefs.getUChar("id", AUTO) != _ID) {
+    prefs.putUChar("id", _ID);
+  }
+  prefs.end();
+}
+
 void WirelessDMXReceiver::_scanNext()
 {
   _locked = _scanChannel();
   if (_locked) {
     return;
   }
+  if (_idleDue() && _idleWait()) {
+    return; // Woke up to a packet on this channel: probe it again
+  }
 
   _channel++;
   if (_channel > 126) {
     _channel = 0;
-    if (_configID == AUTO) {
-      if (_ID < WHITE) {
-        ++_ID;
-      } else {
-        _ID = RED;
+    _nextScanID();
+  }
+  return;
+}
+
+/*
+ * After a full pass over the band, move on to the next unit ID(s) in AUTO mode.
+ */
+void WirelessDMXReceiver::_nextScanID()
+{
+  if (_configID == AUTO) {
+    wdmxID_t lastProbed = (_pairedID() != AUTO) ? _pairedID() : _ID; // Paired unit ID has been probed on pipe 1 already
+    _ID = (lastProbed < WHITE) ? (wdmxID_t)(lastProbed + 1) : RED;
+  }
+}
+
+/*
+ * Probe the next channel while trying to re-acquire a lost signal.
+ *
+ * Transmitters usually come back on the same channel, or - after changing their channel - close to it.
+ * So search outwards from the channel we lost the signal on (origin, origin+1, origin-1, origin+2, ...) using
+ * the last known unit ID first, moving on to other unit IDs after every full pass in AUTO mode.
+ */
+void WirelessDMXReceiver::_relockNext()
+{
+  if (!_probing) {
+    int distance = (_relockStep + 1) / 2;
+    int channel = _relockOrigin + ((_relockStep % 2) ? distance : -distance);
+
+    _relockStep++;
+    if (distance > 126) {
+      _relockStep = 0;
+      _nextScanID();
+      return;
+    }
+    if ((channel < 0) || (channel > 126)) {
+      return;
+    }
+
+    _channel = channel;
+    _startProbe();
+  }
+
+  int result = _pollProbe();
+  if (result <= 0) {
+    return;
+  }
+
+  if (debug) {
+    Serial.printf("RX: Acquired signal on channel %d, unit ID %d\n", _channel, _ID);
+  }
+  _lastReacquire = millis() - _unlockedSince;
+  _idle = false;
+  _locked = true;
+  _lastPacketTime = millis();
+  _firstFrame = true;
+  if (_persistLock) {
+    _saveLastLock();
+  }
+  _lockChanged();
+}
+
+/*
+ * Have the receive task search for a transmitter, starting at the given channel (see _relockNext()).
+ */
+void WirelessDMXReceiver::_startRelock(unsigned int origin)
+{
+  _locked = false;
+  _probing = false;
+  _unlockedSince = millis();
+  _relockOrigin = origin;
+  _relockStep = 0;
+
+  // Whatever we collected of the frame that the loss cut off is stale by the time we are back. Don't let it count
+  // towards the first frame after the relock.
+  _framePending = false;
+  _slotsReceived = 0;
+  _withheld = false;
+}
+
+/*
+ * Tell waitForLock() and the onLockChange() callback about a change of _locked.
+ */
+void WirelessDMXReceiver::_lockChanged()
+{
+  if (_locked) {
+    xEventGroupSetBits(_lockEvents, WDMX_EVENT_LOCKED);
+  } else {
+    xEventGroupClearBits(_lockEvents, WDMX_EVENT_LOCKED);
+  }
+  if (_lockCallback) {
+    _lockCallback(_locked);
+  }
+}
+
+bool WirelessDMXReceiver::waitForLock(uint32_t timeoutMs)
+{
+  TickType_t ticks = (timeoutMs == WDMX_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+  return((xEventGroupWaitBits(_lockEvents, WDMX_EVENT_LOCKED, pdFALSE, pdTRUE, ticks) & WDMX_EVENT_LOCKED) != 0);
+}
+
+/*
+ * Whether we have been searching for long enough to enter idle mode.
+ */
+bool WirelessDMXReceiver::_idleDue()
+{
+  return((_idleAfter != 0) && (millis() - _unlockedSince >= _idleAfter));
+}
+
+/*
+ * Sleep between two probes in idle mode. The radio keeps listening on the channel we probed last.
+ * Returns true if we woke up because a packet arrived there.
+ */
+bool WirelessDMXReceiver::_idleWait()
+{
+  unsigned long started = millis();
+
+  if (!_idle) {
+    _idle = true;
+    if (debug) {
+      Serial.printf("RX: No signal for %d ms, entering idle mode\n", _idleAfter);
+    }
+  }
+
+  if (_lightSleep) {
+    esp_sleep_enable_timer_wakeup((uint64_t)_idleInterval * 1000);
+    if (_irqPin >= 0) {
+      // GPIO wakeup is level triggered and replaces the pin's interrupt type, so take the edge interrupt off first
+      if (_irqAttached) {
+        detachInterrupt(digitalPinToInterrupt(_irqPin));
+      }
+      gpio_wakeup_enable((gpio_num_t)_irqPin, GPIO_INTR_LOW_LEVEL);
+      esp_sleep_enable_gpio_wakeup();
+    }
+    esp_light_sleep_start();
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+    if (_irqPin >= 0) {
+      esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+      gpio_wakeup_disable((gpio_num_t)_irqPin);
+      if (_irqAttached) {
+        attachInterruptArg(digitalPinToInterrupt(_irqPin), _irqHandler, this, FALLING);
       }
     }
+  } else if (_irqAttached) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(_idleInterval));
+  } else {
+    vTaskDelay(pdMS_TO_TICKS(_idleInterval));
   }
-  return;
+
+  _idleTime = _idleTime + (millis() - started);
+  return(_radio->available());
 }
 
-void WirelessDMXReceiver::_dmxReceiveLoop()
+/*
+ * Called from the receive task when no valid packet arrived for _signalTimeout ms.
+ */
+void WirelessDMXReceiver::_signalLost()
+{
+  static const uint8_t blackout[DMX_BUFSIZE] = { 0 };
+
+  if (debug) {
+    Serial.printf("RX: Lost signal on channel %d, unit ID %d\n", _channel, _ID);
+  }
+  _startRelock(_channel);
+  _lockChanged();
+
+  if (_lossPolicy == WDMX_LOSS_BLACKOUT) {
+    _writeChannels(0, blackout, _channelCount.load(std::memory_order_relaxed));
+    _deliver(0, blackout, sizeof(blackout), _allSubscribers);
+    _publishFrame();
+  }
+  _publishStats();
+}
+
+/*
+ * Read all payloads that are waiting in the RX FIFO.
+ *
+ * Every SPI transaction counts here: one status read per pass tells whether there is anything to read, and whether
+ * the FIFO overflowed. After that, each payload read reports whether another one is waiting, so that a single
+ * packet costs two transactions. Keep going until the FIFO is empty, as RX_DR (and with it the IRQ line) is cleared
+ * for packets that arrive while we drain.
+ *
+ * Returns the number of payloads read.
+ */
+unsigned int WirelessDMXReceiver::_drainFifo()
 {
   wdmxReceiveBuffer rxBuf;
-  uint8_t prevPayloadID = 0;
-  bool firstFrame = true;
+  unsigned int count = 0;
+  bool full;
+  bool more;
 
-  while (true) {
-    if (_radio.rxFifoFull()) {
-      _rxOverruns++;
-    }
+  if (!_radio->rxFifoStatus(full)) {
+    return(0);
+  }
 
-    if (_radio.available())
-    {
-      /*
-        * Read DMX values from radio.
-        */
-      _radio.read(&rxBuf, sizeof(rxBuf));
+#ifdef WDMX_INSTRUMENTATION
+  // Packets that were already waiting in the FIFO all get the same arrival time
+  _packetArrival = esp_timer_get_time();
+  if ((_irqPin >= 0) && (_irqTimestamp > _lastPacketTimestamp)) {
+    _packetArrival = _irqTimestamp;
+  }
+#endif
+
+  if (full) {
+    _stats.rxOverruns++;
+  }
+
+  do {
+    more = _radio->readPayload(&rxBuf, sizeof(rxBuf));
+    _handlePacket(rxBuf);
+    count++;
+  } while (more);
+  return(count);
+}
 
+/*
+ * Process a packet that did not come from the radio, e.g. from a capture or a synthetic generator.
+ */
+void WirelessDMXReceiver::processPacket(const wdmxReceiveBuffer& rxBuf)
+{
+#ifdef WDMX_INSTRUMENTATION
+  _packetArrival = esp_timer_get_time();
+#endif
+  _handlePacket(rxBuf);
+}
+
+/*
+ * Process a single packet read from the radio: validate it, check its sequence number, and copy its payload
+ * into the back buffer.
+ */
+void WirelessDMXReceiver::_handlePacket(const wdmxReceiveBuffer& rxBuf)
+{
 #ifdef WDMX_CAPTURE
-      if (_capture) {
-        _captureBuffer.pushOverwrite(rxBuf);
-      }
+  if (_capture.load()) {
+    _captureBusy.store(true);
+    wdmxCaptureRecord* record = _capture.load() ? _captureBuffer.reserve() : nullptr;
+    if (record != nullptr) {
+      record->timestamp = esp_timer_get_time();
+      record->channel = _channel;
+      record->ID = _ID;
+      record->packet = rxBuf;
+      _captureBuffer.commit();
+    }
+    _captureBusy.store(false);
+  }
 #endif
 
-      if ((rxBuf.magic != WDMX_MAGIC_1) && (rxBuf.magic != WDMX_MAGIC_2)) {
-        // Received frame with unexpected magic number. Ignore.
-        _rxInvalid++;
-        continue;
-      }
+  if ((rxBuf.magic != WDMX_MAGIC_1) && (rxBuf.magic != WDMX_MAGIC_2)) {
+    // Received frame with unexpected magic number. Ignore.
+    _stats.rxInvalid++;
+    return;
+  }
 
-      if (firstFrame) {
-        firstFrame = false;
-      } else {
-        if (((rxBuf.payloadID > 0) && (rxBuf.payloadID != prevPayloadID +1 )) || ((rxBuf.payloadID == 0) && prevPayloadID != rxBuf.highestChannelID/sizeof(rxBuf.dmxData))) {
-          // Received a frame with gap in sequence number. We'll process it but count the error.
-          _rxSeqErrors++;
-        }
-      }
+  unsigned int lastSlot = rxBuf.highestChannelID / sizeof(rxBuf.dmxData);
+
+  if (_firstFrame) {
+    // Give WDMX_COMPLETE_ALL_SLOTS the chance to collect a complete first frame
+    _firstFrame = false;
+    _lastPublish = millis();
+  } else {
+    unsigned int expected = (_prevPayloadID >= lastSlot) ? 0 : _prevPayloadID + 1;
+    if (rxBuf.payloadID != expected) {
+      // Received a frame with gap in sequence number. We'll process it but count the error.
+      _stats.rxSeqErrors++;
+      _countLostSlots(expected, rxBuf.payloadID, lastSlot);
+    }
+  }
+
+  // If the payload ID went backwards, the transmitter started a new universe and we never saw the end of the
+  // previous one. Publish whatever we have before starting to overwrite it.
+  if (_framePending && (rxBuf.payloadID < _prevPayloadID) && _frameComplete(lastSlot)) {
+    _publishFrame();
+  }
+
+  _stats.rxCount++;
+  _prevPayloadID = rxBuf.payloadID;
+
+  unsigned int channelCount = min((unsigned int)rxBuf.highestChannelID + 1, (unsigned int)DMX_BUFSIZE);
+  if (channelCount != _channelCount) {
+    _setChannelCount(channelCount);
+  }
+
+  // put payload into dmx buffer, up to the end of the universe. The last payload is padded beyond that.
+  unsigned int dmxChanStart = rxBuf.payloadID * sizeof(rxBuf.dmxData);
+  if (dmxChanStart < channelCount) {
+    unsigned int len = min((unsigned int)sizeof(rxBuf.dmxData), channelCount - dmxChanStart);
+    uint32_t subscribers = _slotSubscribers[rxBuf.payloadID];
+
+    if (!_subscribedOnly || (subscribers != 0)) {
+      _writeChannels(dmxChanStart, rxBuf.dmxData, len);
+    }
+    if (subscribers != 0) {
+      _deliver(dmxChanStart, rxBuf.dmxData, len, subscribers);
+    }
+  }
+  _framePending = true;
+  if (rxBuf.payloadID < WDMX_SLOT_COUNT) {
+    _slotsReceived |= (1UL << rxBuf.payloadID);
+    // Ages are reported at a 100ms+ scale, so the housekeeping timestamp is good enough and saves a millis() per
+    // packet. 0 means "never received".
+    _slotUpdated[rxBuf.payloadID].store((_lastHousekeeping != 0) ? _lastHousekeeping : 1, std::memory_order_relaxed);
+  }
+
+  // The last payload of a universe completes the frame. If we withheld a frame, any payload may complete it.
+  if (((rxBuf.payloadID == lastSlot) || _withheld) && _frameComplete(lastSlot)) {
+    _publishFrame();
+  }
+
+#ifdef WDMX_INSTRUMENTATION
+  if (_lastPacketTimestamp != 0) {
+    _recordSample(WDMX_HIST_PACKET_GAP, _packetArrival - _lastPacketTimestamp);
+  }
+  _lastPacketTimestamp = _packetArrival;
+  _recordSample(WDMX_HIST_PROCESSING, esp_timer_get_time() - _packetArrival);
+#endif
+}
+
+/*
+ * Count the slots from expected up to (but not including) received as lost, wrapping around after lastSlot.
+ */
+void WirelessDMXReceiver::_countLostSlots(unsigned int expected, unsigned int received, unsigned int lastSlot)
+{
+  unsigned int slot = expected;
+
+  for (unsigned int n = 0; (slot != received) && (n < WDMX_SLOT_COUNT); n++) {
+    if (slot < WDMX_SLOT_COUNT) {
+      _slotLosses[slot].store(_slotLosses[slot].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    slot = (slot >= lastSlot) ? 0 : slot + 1;
+  }
+}
+
+/*
+ * Decide whether the back buffer may be published now, according to the completion policy.
+ */
+bool WirelessDMXReceiver::_frameComplete(unsigned int lastSlot)
+{
+  if (_completionPolicy == WDMX_COMPLETE_LAST_SLOT) {
+    return(true);
+  }
+
+  uint32_t allSlots = (lastSlot >= 31) ? 0xFFFFFFFFUL : ((1UL << (lastSlot + 1)) - 1);
+  if (((_slotsReceived & allSlots) == allSlots) || (millis() - _lastPublish >= _maxWithhold)) {
+    return(true);
+  }
+
+  if (!_withheld) {
+    _withheld = true;
+    _stats.framesWithheld++;
+  }
+  return(false);
+}
 
-      _rxCount++;
-      prevPayloadID = rxBuf.payloadID;
-      esp_task_wdt_reset();
+/*
+ * The transmitter changed the size of the universe. Channels beyond the end of the universe read as zero.
+ */
+void WirelessDMXReceiver::_setChannelCount(unsigned int count)
+{
+  static const uint8_t blackout[DMX_BUFSIZE] = {};
 
-      int dmxChanStart = rxBuf.payloadID* sizeof(rxBuf.dmxData);
+  if (debug) {
+    Serial.printf("RX: Universe size changed from %d to %d channels\n", _channelCount.load(), count);
+  }
+  if (count < _channelCount) {
+    _writeChannels(count, blackout, _channelCount - count);
+    _deliver(count, blackout, _channelCount - count, _allSubscribers);
+    // The other two triple buffers still hold the old data beyond count. Seed them with the cleared tail.
+    _fullSeeds = 2;
+  }
+  _channelCount.store(count, std::memory_order_relaxed);
+}
 
-      // put payload into dmx buffer. If data goes beyond 512 channels, wrap over.
-      memcpy(&dmxBuffer[dmxChanStart], &rxBuf.dmxData, min(sizeof(rxBuf.dmxData), sizeof(dmxBuffer)-dmxChanStart));
-      if (dmxChanStart+sizeof(rxBuf.dmxData) > sizeof(dmxBuffer)) {
-        memcpy(&dmxBuffer, &rxBuf.dmxData[sizeof(dmxBuffer)-dmxChanStart], dmxChanStart+sizeof(rxBuf.dmxData)-sizeof(dmxBuffer));
+/*
+ * Copy received channel data into the back buffer, recording which channels changed.
+ */
+void WirelessDMXReceiver::_writeChannels(unsigned int start, const uint8_t* data, size_t len)
+{
+  for (unsigned int i = 0; i < len; i++) {
+    if (_backBuffer[start+i] != data[i]) {
+      unsigned int channel = start+i;
+      _frameDirty[channel / 32] |= (1UL << (channel % 32));
+      if ((_frameChangeFirst < 0) || ((int)channel < _frameChangeFirst)) {
+        _frameChangeFirst = channel;
+      }
+      if ((int)channel > _frameChangeLast) {
+        _frameChangeLast = channel;
       }
+    }
+  }
+  memcpy(&_backBuffer[start], data, len);
+}
 
-      // Pulse status LED when we're receiving
-      if (_statusLEDPin != 0) {
-        if ((_rxCount / 1024) % 2) {
-          analogWrite(_statusLEDPin, (_rxCount % 1024)/4);
-        } else {
-          analogWrite(_statusLEDPin, 255-((_rxCount % 1024)/4));
-        }
+/*
+ * Copy received channel data into the destinations of the given subscriptions (a bitmap of indices into
+ * _subscriptions), as far as they overlap.
+ */
+void WirelessDMXReceiver::_deliver(unsigned int start, const uint8_t* data, size_t len, uint32_t subscribers)
+{
+  while (subscribers != 0) {
+    wdmxSubscription& subscription = _subscriptions[__builtin_ctz(subscribers)];
+    unsigned int first = max(start, subscription.start);
+    unsigned int last = min(start + (unsigned int)len, subscription.start + subscription.length);
+
+    subscribers &= subscribers - 1;
+    if (first < last) {
+      memcpy(&subscription.destination[first - subscription.start], &data[first - start], last - first);
+      subscription.generation.fetch_add(1, std::memory_order_release);
+    }
+  }
+}
+
+/*
+ * Make the back buffer visible to readers.
+ *
+ * In WDMX_BUFFER_TRIPLE mode, the back buffer becomes the new front buffer, and the receive task moves on to the
+ * buffer that was published two frames ago. That buffer is seeded with the new front buffer, so that payloads we
+ * miss in the next frame keep their most recent value. Readers that picked up a front buffer pointer therefore
+ * have at least one full frame period before the data underneath them changes.
+ */
+void WirelessDMXReceiver::_publishFrame()
+{
+  uint32_t generation = _frameGeneration.load(std::memory_order_relaxed) + 1;
+  const uint8_t* published = _backBuffer;
+
+  _framePending = false;
+  _slotsReceived = 0;
+  _withheld = false;
+  _lastPublish = millis();
+  if (_bufferMode == WDMX_BUFFER_TRIPLE) {
+    _frontBuffer.store(_backBuffer, std::memory_order_release);
+    _frameGeneration.store(generation, std::memory_order_release);
+
+    // Order the generation update before any write into the new back buffer (see readSnapshot()).
+    std::atomic_thread_fence(std::memory_order_release);
+    _backIndex = (_backIndex + 1) % 3;
+    if (_fullSeeds > 0) {
+      _fullSeeds--;
+      memcpy(_frames[_backIndex], _backBuffer, DMX_BUFSIZE);
+    } else {
+      memcpy(_frames[_backIndex], _backBuffer, _channelCount.load(std::memory_order_relaxed));
+    }
+    _backBuffer = _frames[_backIndex];
+  } else {
+    _frameGeneration.store(generation, std::memory_order_release);
+  }
+
+#ifdef WDMX_INSTRUMENTATION
+  int64_t now = esp_timer_get_time();
+  if (_lastFrameTimestamp != 0) {
+    _recordSample(WDMX_HIST_FRAME_GAP, now - _lastFrameTimestamp);
+  }
+  _lastFrameTimestamp = now;
+#endif
+
+  if (_frameQueue.isAllocated()) {
+    wdmxFrame* frame = _frameQueue.reserve();
+    if (frame != nullptr) {
+      frame->timestamp = esp_timer_get_time();
+      frame->generation = generation;
+      frame->channelCount = _channelCount.load(std::memory_order_relaxed);
+      memcpy(frame->data, published, frame->channelCount);
+      _frameQueue.commit();
+    } else {
+      _stats.frameQueueOverruns++;
+    }
+  }
+
+  // Hand this frame's changes to readers only now, so that they are never ahead of the published data.
+  if (_frameChangeFirst >= 0) {
+    for (unsigned int i = 0; i < WDMX_DIRTY_WORDS; i++) {
+      if (_frameDirty[i] != 0) {
+        _dirty[i].fetch_or(_frameDirty[i], std::memory_order_release);
+        _frameDirty[i] = 0;
       }
     }
+    _changeGeneration.fetch_add(1, std::memory_order_release);
+    if (_changeCallback) {
+      _changeCallback(_frameChangeFirst+1, _frameChangeLast-_frameChangeFirst+1);
+    }
+    _frameChangeFirst = -1;
+    _frameChangeLast = -1;
+  }
+
+  _runningFrameCallbacks.store(true);
+  for (unsigned int i = 0; i < _frameCallbackCount; i++) {
+    if (_frameCallbackActive[i].load()) {
+      _frameCallbacks[i]();
+    }
+  }
+  _runningFrameCallbacks.store(false);
+}
+
+int WirelessDMXReceiver::subscribe(unsigned int startAddress, unsigned int length, void* destination)
+{
+  if ((_subscriptionCount >= WDMX_MAX_SUBSCRIPTIONS) || (destination == nullptr) || (length == 0) ||
+      (startAddress < 1) || (startAddress - 1 + length > DMX_BUFSIZE)) {
+    return(-1);
+  }
+
+  int index = _subscriptionCount++;
+  wdmxSubscription& subscription = _subscriptions[index];
+  subscription.start = startAddress - 1;
+  subscription.length = length;
+  subscription.destination = (uint8_t*)destination;
+  subscription.generation.store(0);
+
+  // Note the subscription in the lookup table of every slot it overlaps
+  for (unsigned int slot = subscription.start / WDMX_SLOT_CHANNELS; slot <= (subscription.start + length - 1) / WDMX_SLOT_CHANNELS; slot++) {
+    _slotSubscribers[slot] |= (1UL << index);
+  }
+  _allSubscribers |= (1UL << index);
+  return(index);
+}
+
+unsigned long WirelessDMXReceiver::slotAge(unsigned int slot) const
+{
+  uint32_t updated = (slot < WDMX_SLOT_COUNT) ? _slotUpdated[slot].load(std::memory_order_relaxed) : 0;
+
+  if (updated == 0) {
+    return(ULONG_MAX); // Never received
+  }
+  return(millis() - updated);
+}
+
+int WirelessDMXReceiver::addFrameCallback(std::function<void()> callback)
+{
+  if (_frameCallbackCount >= WDMX_MAX_FRAME_CALLBACKS) {
+    return(-1);
+  }
+  int index = _frameCallbackCount;
+  _frameCallbacks[index] = callback;
+  _frameCallbackActive[index].store(true);
+  _frameCallbackCount++;
+  return(index);
+}
+
+void WirelessDMXReceiver::removeFrameCallback(int index)
+{
+  if ((index < 0) || (index >= (int)_frameCallbackCount)) {
+    return;
+  }
+  _frameCallbackActive[index].store(false);
+
+  // The receive task may have checked the flag just before we cleared it; wait until it is done with the callbacks
+  while (_runningFrameCallbacks.load()) {
+    delay(1);
+  }
+}
+
+bool WirelessDMXReceiver::fetchAndClearDirty(uint32_t bitmap[WDMX_DIRTY_WORDS])
+{
+  bool changed = false;
+
+  for (unsigned int i = 0; i < WDMX_DIRTY_WORDS; i++) {
+    bitmap[i] = _dirty[i].exchange(0, std::memory_order_acquire);
+    if (bitmap[i] != 0) {
+      changed = true;
+    }
+  }
+  return(changed);
+}
+
+/*
+ * Seqlock style reader for the front buffer.
+ *
+ * A buffer published as generation N only becomes the back buffer again when generation N+2 is published. If the
+ * generation advanced by less than two while we were copying, nothing wrote to the buffer underneath us.
+ */
+bool WirelessDMXReceiver::readSnapshot(uint8_t* dst, size_t len, uint32_t* gen) const
+{
+  uint32_t startGeneration = _frameGeneration.load(std::memory_order_acquire);
+  uint32_t maxAdvance = (_bufferMode == WDMX_BUFFER_TRIPLE) ? 2 : 1;
+
+  if ((gen != nullptr) && (*gen == startGeneration)) {
+    return(false);
+  }
+
+  len = min(len, sizeof(dmxBuffer));
+  while (true) {
+    memcpy(dst, getFrame(), len);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t endGeneration = _frameGeneration.load(std::memory_order_relaxed);
+    if (endGeneration - startGeneration < maxAdvance) {
+      break;
+    }
+    startGeneration = _frameGeneration.load(std::memory_order_acquire);
+  }
+
+  if (gen != nullptr) {
+    *gen = startGeneration;
+  }
+  return(true);
+}
+
+/*
+ * Do whatever the receiver needs to do right now, without blocking: search for a transmitter while unlocked,
+ * otherwise drain the RX FIFO and detect signal loss. Called from the receive task, or from the task of a
+ * WirelessDMXReceiverGroup.
+ */
+void WirelessDMXReceiver::_service()
+{
+  unsigned long now = millis();
+
+  if (now - _lastHousekeeping >= WDMX_HOUSEKEEPING_MS) {
+    _housekeeping(now);
+  }
+
+  if (!_locked) {
+    if (!_probing && _idleDue() && _idleWait()) {
+      _startProbe(); // Woke up to a packet on the channel we probed last: probe it again
+    }
+    _relockNext();
+    return;
+  }
+
+  if ((_signalTimeout != 0) && (now - _lastPacketTime > _signalTimeout)) {
+    _signalLost();
+    return;
+  }
+
+  _drainFifo();
+}
+
+/*
+ * Attach the radio IRQ handler, if we have an IRQ pin. Must be called from the task that services this receiver:
+ * the handler notifies _dmxReceiveTask, and is serviced on the core it was attached from.
+ */
+void WirelessDMXReceiver::_attachIRQ()
+{
+  _dmxReceiveTask = xTaskGetCurrentTaskHandle();
+  _lastPacketTime = millis();
+  _lastHousekeeping = _lastPacketTime;
+  if (_irqPin >= 0) {
+    pinMode(_irqPin, INPUT_PULLUP);
+    attachInterruptArg(digitalPinToInterrupt(_irqPin), _irqHandler, this, FALLING);
+    _irqAttached = true;
+  }
+}
+
+void WirelessDMXReceiver::_dmxReceiveLoop()
+{
+  unsigned long lastYield = millis();
+
+  _attachIRQ();
+  while (!_stopRequested) {
+    _service();
+    if (_locked && (_irqPin >= 0)) {
+      /*
+       * Sleep until the radio signals RX_DR. The IRQ line only goes high again once all pending RX_DR flags are
+       * cleared, which _service() does by draining the FIFO completely. The timeout ensures that we recover even
+       * if we missed an edge.
+       */
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WDMX_IRQ_TIMEOUT_MS));
+    } else if (millis() - lastYield >= WDMX_POLL_YIELD_MS) {
+      // Polling never blocks. Let lower priority tasks, including the idle task that feeds the watchdog, run.
+      vTaskDelay(1);
+      lastYield = millis();
+    }
+  }
+
+  if (_irqAttached) {
+    detachInterrupt(digitalPinToInterrupt(_irqPin));
+    _irqAttached = false;
+  }
+  esp_task_wdt_delete(nullptr);
+  _taskRunning = false;   // end() returns once this is cleared; don't touch any members after this
+  vTaskDelete(nullptr);
+}
+
+/*
+ * Periodic bookkeeping that does not need to happen for every packet: feed the watchdog, note whether we received
+ * anything since the last call, and make the counters visible to other tasks.
+ */
+void WirelessDMXReceiver::_housekeeping(unsigned long now)
+{
+  esp_task_wdt_reset();
+#ifdef WDMX_INSTRUMENTATION
+  if (_histogramReset.exchange(false)) {
+    memset(_histograms, 0x00, sizeof(_histograms));
+  }
+#endif
+  if (_stats.rxCount != _housekeepingRxCount) {
+    _housekeepingRxCount = _stats.rxCount;
+    _lastPacketTime = now;
+  }
+  _publishStats();
+  _lastHousekeeping = now;
+}
+
+void WirelessDMXReceiver::_publishStats()
+{
+  uint32_t sequence = _statsSequence.load(std::memory_order_relaxed);
+
+  _statsSequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  _publishedStats = _stats;
+  _statsSequence.store(sequence + 2, std::memory_order_release);
+}
+
+void WirelessDMXReceiver::getStats(wdmxStats& stats) const
+{
+  uint32_t sequence;
+
+  do {
+    sequence = _statsSequence.load(std::memory_order_acquire);
+    stats = _publishedStats;
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((sequence & 1) || (sequence != _statsSequence.load(std::memory_order_relaxed)));
+}
+
+/*
+ * Radio IRQ handler, only used if an IRQ pin was given. Wakes up the receive task.
+ */
+void IRAM_ATTR WirelessDMXReceiver::_irqHandler(void* _this)
+{
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+
+#ifdef WDMX_INSTRUMENTATION
+  ((WirelessDMXReceiver*)_this)->_irqTimestamp = esp_timer_get_time();
+#endif
+  vTaskNotifyGiveFromISR(((WirelessDMXReceiver*)_this)->_dmxReceiveTask, &higherPriorityTaskWoken);
+  if (higherPriorityTaskWoken) {
+    portYIELD_FROM_ISR();
   }
 }
 
@@ -168,10 +967,79 @@ void WirelessDMXReceiver::_startDMXReceiveThread(void* _this)
   ((WirelessDMXReceiver*)_this)->_dmxReceiveLoop();
 }
 
-WirelessDMXReceiver::WirelessDMXReceiver(int cePin, int csnPin, int statusLEDPin)
-  : _radio(cePin, csnPin)
+/*
+ * Clear all DMX buffers and set up the pointers for the current buffer mode.
+ */
+void WirelessDMXReceiver::_resetBuffers()
 {
-  _statusLEDPin = statusLEDPin;
+  memset(&dmxBuffer, 0x00, sizeof(dmxBuffer)); // Clear DMX buffer
+  memset(&_frames, 0x00, sizeof(_frames));
+  _channelCount.store(DMX_BUFSIZE, std::memory_order_relaxed);
+  _fullSeeds = 0;
+  _framePending = false;
+  _slotsReceived = 0;
+  _withheld = false;
+  if (_bufferMode == WDMX_BUFFER_TRIPLE) {
+    _backIndex = 0;
+    _backBuffer = _frames[0];
+    _frontBuffer.store(_frames[2], std::memory_order_release);
+  } else {
+    _backBuffer = dmxBuffer;
+    _frontBuffer.store(dmxBuffer, std::memory_order_release);
+  }
+}
+
+WirelessDMXReceiver::WirelessDMXReceiver(int cePin, int csnPin, int statusLEDPin, int irqPin, uint32_t spiSpeed, SPIClass* spiBus)
+  : _statusLED(statusLEDPin), _rf24Radio(new WirelessDMXRF24Radio(cePin, csnPin, spiSpeed, spiBus))
+{
+  _radio = _rf24Radio;
+  _init(irqPin);
+}
+
+WirelessDMXReceiver::WirelessDMXReceiver(WirelessDMXRadio& radio, int statusLEDPin, int irqPin)
+  : _statusLED(statusLEDPin)
+{
+  _radio = &radio;
+  _init(irqPin);
+}
+
+WirelessDMXReceiver::~WirelessDMXReceiver()
+{
+  end();
+  vEventGroupDelete(_lockEvents);
+  delete _rf24Radio;
+}
+
+void WirelessDMXReceiver::_init(int irqPin)
+{
+  _irqPin = irqPin;
+  // Statically allocated, so that this works in global constructors, and created here, so that waitForLock() can
+  // be called from any task before begin()
+  _lockEvents = xEventGroupCreateStatic(&_lockEventsBuffer);
+  _backBuffer = dmxBuffer;
+  _frontBuffer.store(dmxBuffer);
+  _frameGeneration.store(0);
+  _statsSequence.store(0);
+#ifdef WDMX_CAPTURE
+  _capture.store(false);
+  _captureBusy.store(false);
+#endif
+#ifdef WDMX_INSTRUMENTATION
+  memset(_histograms, 0x00, sizeof(_histograms));
+  _histogramReset.store(false);
+#endif
+  memset(_frameDirty, 0x00, sizeof(_frameDirty));
+  for (unsigned int i = 0; i < WDMX_DIRTY_WORDS; i++) {
+    _dirty[i].store(0);
+  }
+  for (unsigned int i = 0; i < WDMX_MAX_FRAME_CALLBACKS; i++) {
+    _frameCallbackActive[i].store(false);
+  }
+  _runningFrameCallbacks.store(false);
+  for (unsigned int i = 0; i < WDMX_SLOT_COUNT; i++) {
+    _slotUpdated[i].store(0);
+    _slotLosses[i].store(0);
+  }
 }
 
 void WirelessDMXReceiver::begin(wdmxID_t ID)
@@ -179,22 +1047,26 @@ void WirelessDMXReceiver::begin(wdmxID_t ID)
   begin(ID, nullptr);
 }
 
-void WirelessDMXReceiver::begin(wdmxID_t ID, std::function<void()> scanCallback)
-{ 
-  if (!_radio.begin()){
+/*
+ * Start the radio and prepare for scanning, without scanning yet.
+ */
+void WirelessDMXReceiver::_setup(wdmxID_t ID)
+{
+  // Runs off its own timer, so that it blinks while we scan
+  _statusLED.begin(*this);
+
+  if (!_radio->begin()){
     if (debug) {
       Serial.println("ERROR: failed to start radio");
     }
   }
 
-  _radio.setDataRate(RF24_250KBPS);
-  _radio.setCRCLength(RF24_CRC_16);
-  _radio.setPALevel(RF24_PA_LOW);
-  _radio.setAutoAck(false);
-  _radio.setPayloadSize(WDMX_PAYLOAD_SIZE);
+  if (_irqPin >= 0) {
+    _radio->maskIRQ(true, true, false); // We only care about RX_DR
+  }
 
   if (debug) {
-    _radio.printPrettyDetails();
+    _radio->printPrettyDetails();
   }
 
   // Initial configuration to begin scanning
@@ -206,45 +1078,139 @@ void WirelessDMXReceiver::begin(wdmxID_t ID, std::function<void()> scanCallback)
   } else {
     _ID = _configID;
   }
+  _resetBuffers();
+}
+
+/*
+ * Prepare for the receive task (our own, or that of a WirelessDMXReceiverGroup) to search for the transmitter,
+ * starting with the last known channel and unit ID.
+ */
+void WirelessDMXReceiver::_setupAsync(wdmxID_t ID)
+{
+  unsigned int savedChannel;
+  wdmxID_t savedID;
+
+  _setup(ID);
+  if (_persistLock && _loadLastLock(savedChannel, savedID)) {
+    _ID = savedID;
+    _startRelock(savedChannel);
+  } else {
+    _startRelock(0);
+  }
+}
+
+void WirelessDMXReceiver::begin(wdmxID_t ID, std::function<void()> scanCallback)
+{ 
+  _setup(ID);
 
   // Scan for receiver. If we were given a callback function, invoke the callback function between scan attempts.
+  _unlockedSince = millis();
+  if (_persistLock) {
+    _locked = _probeLastLock();
+  }
   while(!_locked) {
     _scanNext();
     if (scanCallback) {
       scanCallback();
     }
   }
+  _lastReacquire = millis() - _unlockedSince;
+  _idle = false;
+  if (_persistLock) {
+    _saveLastLock();
+  }
+  _lockChanged();
 
-  // Clear the DMX buffer
-  memset(&dmxBuffer, 0x00, sizeof(dmxBuffer)); // Clear DMX buffer
+  _startTask();
+}
+
+void WirelessDMXReceiver::beginAsync(wdmxID_t ID)
+{
+  _setupAsync(ID);
+  _startTask();
+}
+
+void WirelessDMXReceiver::_startTask()
+{
+  _stopRequested = false;
+  _taskRunning = true;
 
   // Start the output task
   xTaskCreatePinnedToCore(
-    _startDMXReceiveThread, /* Function to implement the task */
-    "DMX Receive Thread",   /* Name of the task */
-    10000,                  /* Stack size in words */
-    this,                   /* Task input parameter */
-    0,                      /* Priority of the task */
-    &_dmxReceiveTask,       /* Task handle. */
-    0                       /* Core where the task should run */
+    _startDMXReceiveThread,   /* Function to implement the task */
+    "DMX Receive Thread",     /* Name of the task */
+    _taskConfig.stackSize,    /* Stack size in bytes (not words, on ESP32) */
+    this,                     /* Task input parameter */
+    _taskConfig.priority,     /* Priority of the task */
+    &_dmxReceiveTask,         /* Task handle. */
+    _taskConfig.core          /* Core where the task should run */
   );
   esp_task_wdt_add(_dmxReceiveTask);
 }
 
-void WirelessDMXReceiver::startCapture()
+void WirelessDMXReceiver::end()
+{
+  if (!_taskRunning) {
+    return;
+  }
+  _stopRequested = true;
+  xTaskNotifyGive(_dmxReceiveTask);
+  while (_taskRunning) {
+    delay(1);
+  }
+  _dmxReceiveTask = nullptr;
+  _statusLED.end();
+
+  if (_locked) {
+    _locked = false;
+    _lockChanged();
+  }
+}
+
+bool WirelessDMXReceiver::startCapture(size_t depth)
 {
 #ifdef WDMX_CAPTURE
-  _capture = true;
+  if (_captureBuffer.capacity() != depth) {
+    _releaseCapture();
+    if (!_captureBuffer.begin(depth, true)) {
+      return(false);
+    }
+  }
+  _captureHeaderPending = true;
+  _capture.store(true);
+  return(true);
+#else
+  return(false);
 #endif  
 }
 
 void WirelessDMXReceiver::stopCapture()
 {
 #ifdef WDMX_CAPTURE
-  _capture = false;
+  _capture.store(false);
+#endif  
+}
+
+void WirelessDMXReceiver::clearCapture()
+{
+#ifdef WDMX_CAPTURE
+  _releaseCapture();
 #endif  
 }
 
+#ifdef WDMX_CAPTURE
+/*
+ * Stop capturing and free the capture buffer, making sure the receive task isn't writing to it right now.
+ */
+void WirelessDMXReceiver::_releaseCapture()
+{
+  _capture.store(false);
+  while (_captureBusy.load()) {
+  }
+  _captureBuffer.end();
+}
+#endif
+
 bool WirelessDMXReceiver::isCaptureBufferFull()
 {
 #ifdef WDMX_CAPTURE
@@ -257,15 +1223,151 @@ bool WirelessDMXReceiver::isCaptureBufferFull()
 void WirelessDMXReceiver::printCapture()
 {
 #ifdef WDMX_CAPTURE
-  wdmxReceiveBuffer buf;
+  wdmxCaptureRecord record;
+  const wdmxReceiveBuffer& buf = record.packet;
   unsigned int i=0;
-  while (_captureBuffer.pop(buf)) {
+  while ((i < _captureBuffer.capacity()) && _captureBuffer.pop(record)) { // Don't keep printing forever while capture is running
     i++;
     Serial.printf("Pkt %04d Magic %02x Payload %02x (%d) HighestChannel %04x (%d), Data ", i, buf.magic, buf.payloadID, buf.payloadID, buf.highestChannelID, buf.highestChannelID);
-    for (int j = 0; j < sizeof(buf.dmxData); j++) {
+    for (unsigned int j = 0; j < sizeof(buf.dmxData); j++) {
       Serial.printf("%02x ", buf.dmxData[j]);
     }
     Serial.printf("\n");
   }
+  if (!_capture.load()) {
+    _releaseCapture();
+  }
+#endif
+}
+
+size_t WirelessDMXReceiver::streamCapture(Print& out, size_t maxPackets)
+{
+#ifdef WDMX_CAPTURE
+  struct __attribute__((packed)) {
+    uint32_t magic = 0xa1b2c3d4;   // Microsecond timestamps, native byte order
+    uint16_t versionMajor = 2;
+    uint16_t versionMinor = 4;
+    int32_t thisZone = 0;
+    uint32_t sigFigs = 0;
+    uint32_t snapLen = 2 + sizeof(wdmxReceiveBuffer);
+    uint32_t linkType = WDMX_PCAP_LINKTYPE;
+  } fileHeader;
+  struct __attribute__((packed)) {
+    uint32_t tsSec;
+    uint32_t tsUsec;
+    uint32_t inclLen;
+    uint32_t origLen;
+    uint8_t channel;
+    uint8_t ID;
+    wdmxReceiveBuffer packet;
+  } packetRecord;
+  wdmxCaptureRecord record;
+  size_t count = 0;
+
+  if (_captureHeaderPending) {
+    out.write((const uint8_t*)&fileHeader, sizeof(fileHeader));
+    _captureHeaderPending = false;
+  }
+
+  maxPackets = min(maxPackets, _captureBuffer.capacity()); // Don't keep streaming forever if out is faster than the radio
+  while ((count < maxPackets) && _captureBuffer.pop(record)) {
+    packetRecord.tsSec = record.timestamp / 1000000;
+    packetRecord.tsUsec = record.timestamp % 1000000;
+    packetRecord.inclLen = 2 + sizeof(record.packet);
+    packetRecord.origLen = packetRecord.inclLen;
+    packetRecord.channel = record.channel;
+    packetRecord.ID = record.ID;
+    packetRecord.packet = record.packet;
+    out.write((const uint8_t*)&packetRecord, sizeof(packetRecord));
+    count++;
+  }
+  if (!_capture.load() && (count < maxPackets)) {
+    _releaseCapture(); // Capture stopped and everything has been written
+  }
+  return(count);
+#else
+  return(0);
 #endif
-}
\ No newline at end of file
+}
+
+#ifdef WDMX_INSTRUMENTATION
+void WirelessDMXReceiver::_recordSample(wdmxHistogramID_t id, int64_t us)
+{
+  wdmxHistogram& histogram = _histograms[id];
+  uint32_t value = (us < 0) ? 0 : ((us > UINT32_MAX) ? UINT32_MAX : us);
+  unsigned int bucket = 31 - __builtin_clz(value | 1);
+
+  histogram.buckets[min(bucket, (unsigned int)WDMX_HISTOGRAM_BUCKETS - 1)]++;
+  if ((histogram.count == 0) || (value < histogram.min)) {
+    histogram.min = value;
+  }
+  if (value > histogram.max) {
+    histogram.max = value;
+  }
+  histogram.sum += value;
+  histogram.count++;
+}
+#endif
+
+bool WirelessDMXReceiver::getHistogram(wdmxHistogramID_t id, wdmxHistogram& histogram) const
+{
+#ifdef WDMX_INSTRUMENTATION
+  if (id >= WDMX_HIST_COUNT) {
+    return(false);
+  }
+  histogram = _histograms[id];
+  return(true);
+#else
+  return(false);
+#endif
+}
+
+int64_t WirelessDMXReceiver::lastPacketTimestamp() const
+{
+#ifdef WDMX_INSTRUMENTATION
+  return(_lastPacketTimestamp);
+#else
+  return(0);
+#endif
+}
+
+int64_t WirelessDMXReceiver::lastFrameTimestamp() const
+{
+#ifdef WDMX_INSTRUMENTATION
+  return(_lastFrameTimestamp);
+#else
+  return(0);
+#endif
+}
+
+/*
+ * Histograms are cleared by the receive task on its next housekeeping run, to avoid racing with it.
+ */
+void WirelessDMXReceiver::resetHistograms()
+{
+#ifdef WDMX_INSTRUMENTATION
+  _histogramReset.store(true);
+#endif
+}
+
+void WirelessDMXReceiver::printHistograms()
+{
+#ifdef WDMX_INSTRUMENTATION
+  static const char* names[WDMX_HIST_COUNT] = { "Packet gap", "Frame gap", "Processing" };
+  wdmxHistogram histogram;
+
+  for (int i = 0; i < WDMX_HIST_COUNT; i++) {
+    getHistogram((wdmxHistogramID_t)i, histogram);
+    Serial.printf("%s: count %lu, min %luus, avg %lluus, max %luus\n", names[i], (unsigned long)histogram.count,
+                  (unsigned long)histogram.min,
+                  (unsigned long long)((histogram.count > 0) ? histogram.sum / histogram.count : 0),
+                  (unsigned long)histogram.max);
+    for (int j = 0; j < WDMX_HISTOGRAM_BUCKETS; j++) {
+      if (histogram.buckets[j] > 0) {
+        Serial.printf("  %8lu - %8luus: %lu\n", (j == 0) ? 0UL : (1UL << j), (1UL << (j+1)) - 1,
+                      (unsigned long)histogram.buckets[j]);
+      }
+    }
+  }
+#endif
+}
@@ -14,18 +14,51 @@
 #define WirelessDMXReceiver_h
 
 #include "Arduino.h"
-#include <nRF24L01.h>
-#include <RF24.h>
-#include <RingBuf.h>
+#include "WirelessDMXRadio.h"
+#include <esp_heap_caps.h>
+#include <freertos/event_groups.h>
+#include <Preferences.h>
+#include <atomic>
+#include "WirelessDMXStatusLED.h"
 
 #define DMX_BUFSIZE                   512   // Total number of channels in a DMX universe
 #define WDMX_PAYLOAD_SIZE              32   // Payload size in the NRF24L01 protocol
 #define WDMX_HEADER_SIZE                4   // Header size in the NRF24L01 protocol
 #define WDMX_MAGIC_1                 0x80   // Magic number expected in byte 0 of most packet
 #define WDMX_MAGIC_2                 0xA0   // Magic number received in every 14th packet. Not sure what the significance of that is.
+#define WDMX_RX_FIFO_DEPTH              3   // Number of payloads the NRF24L01 RX FIFO can hold
+#define WDMX_DIRTY_WORDS (DMX_BUFSIZE/32)   // Number of 32 bit words in the dirty channel bitmap
+#define WDMX_SLOT_CHANNELS (WDMX_PAYLOAD_SIZE - WDMX_HEADER_SIZE)   // Channels per payload ("slot")
+#define WDMX_SLOT_COUNT ((DMX_BUFSIZE + WDMX_SLOT_CHANNELS - 1) / WDMX_SLOT_CHANNELS) // Slots in a full universe
+#define WDMX_WITHHOLD_MAX_MS          100   // Default for how long WDMX_COMPLETE_ALL_SLOTS may withhold a frame
+#define WDMX_IRQ_TIMEOUT_MS            10   // In IRQ mode, poll the radio anyway if we haven't seen an interrupt for this long
+#define WDMX_SCAN_TIMEOUT_US        10000   // Time to wait for a packet on each channel while scanning
+#define WDMX_SCAN_CARRIER_US         1000   // In WDMX_SCAN_FAST mode, time to look for a carrier before moving on. Must exceed
+                                            // the gap between two packets (about 0.55ms of each 1.85ms packet period).
+#define WDMX_HOUSEKEEPING_MS           10   // Interval to feed the watchdog and publish statistics at
+#define WDMX_SIGNAL_TIMEOUT_MS       1000   // Default time without valid packets after which we consider the signal lost
+#define WDMX_MAX_FRAME_CALLBACKS        4   // Maximum number of callbacks registered with addFrameCallback()
+#define WDMX_MAX_SUBSCRIPTIONS         32   // Maximum number of channel ranges registered with subscribe()
+#define WDMX_NVS_NAMESPACE         "wdmx"   // Default NVS namespace to persist the last lock in
+#define WDMX_LOCK_PROBE_RETRIES         5   // Number of times to probe the persisted channel before scanning
+#define WDMX_WAIT_FOREVER      0xFFFFFFFF   // waitForLock() timeout to wait indefinitely
+#define WDMX_EVENT_LOCKED          (1 << 0)   // Lock event group bit, set while locked
+#define WDMX_IDLE_INTERVAL_MS         100   // Default time to sleep between two channel probes in idle mode
+#define WDMX_TASK_CORE                  0   // Default core to run the receive task on. Use tskNO_AFFINITY to let the scheduler pick.
+#define WDMX_TASK_PRIORITY             10   // Default receive task priority. Above the Arduino loop task (1), below WiFi (23).
+#define WDMX_TASK_STACK_SIZE         4096   // Default receive task stack size in bytes. onChange() and frame callbacks also run on it.
+#define WDMX_POLL_YIELD_MS              4   // Without an IRQ pin, yield to lower priority tasks this often. Must be shorter than
+                                            // the time to fill the RX FIFO (three packets, about 5.5ms).
 
-// Enable the following to support DMX packet capture. This is disabled by default to reduce stack memory usage.
+// Enable the following to support DMX packet capture. The capture buffer is only allocated once a capture is started.
 #define WDMX_CAPTURE
+#define WDMX_CAPTURE_DEPTH           2048   // Default number of packets to capture
+#define WDMX_PCAP_LINKTYPE            147   // LINKTYPE_USER0. Each pcap record holds RF channel, unit ID and the raw payload.
+
+// Enable the following to record per-packet timestamps and keep latency/jitter histograms. This is disabled by default;
+// when disabled, it adds no code or memory to the receive path.
+// #define WDMX_INSTRUMENTATION
+#define WDMX_HISTOGRAM_BUCKETS         24   // Histogram bucket n counts samples of [2^n, 2^(n+1)) microseconds
 
 enum wdmxID_t {                             // Unit IDs (aka ID LED Codes, or Channel Groups, depending on manufacturer)
   AUTO = 0,
@@ -38,11 +71,127 @@ enum wdmxID_t {                             // Unit IDs (aka ID LED Codes, or Ch
   WHITE = 7
 };
 
+enum wdmxBufferMode_t {                     // How received data is handed to readers
+  WDMX_BUFFER_DIRECT = 0,                   // Write packets straight into dmxBuffer. Readers may see a mix of two frames.
+  WDMX_BUFFER_TRIPLE = 1                    // Assemble frames in a back buffer and publish each complete frame atomically
+};
+
+enum wdmxScanMode_t {                       // How to probe each channel while scanning
+  WDMX_SCAN_EXHAUSTIVE = 0,                 // Wait for a packet on every channel
+  WDMX_SCAN_FAST = 1                        // Skip channels without a carrier (received power below -64dBm)
+};
+
+enum wdmxLossPolicy_t {                     // What to do with the DMX data when the signal is lost
+  WDMX_LOSS_HOLD = 0,                       // Keep the last received values
+  WDMX_LOSS_BLACKOUT = 1                    // Set all channels to zero
+};
+
+enum wdmxCompletionPolicy_t {               // When to publish a frame
+  WDMX_COMPLETE_LAST_SLOT = 0,              // When the last slot of the universe arrives, even if others were lost
+  WDMX_COMPLETE_ALL_SLOTS = 1               // Once every slot of the universe arrived since the last frame
+};
+
+enum wdmxHistogramID_t {                    // Histograms kept with WDMX_INSTRUMENTATION
+  WDMX_HIST_PACKET_GAP = 0,                 // Time between arrival of two consecutive valid packets
+  WDMX_HIST_FRAME_GAP = 1,                  // Time between two published frames
+  WDMX_HIST_PROCESSING = 2,                 // Time from packet arrival until its data is in the DMX buffer
+  WDMX_HIST_COUNT = 3
+};
+
+struct wdmxTaskConfig {                     // Placement of the receive task, see setTaskConfig()
+  BaseType_t core = WDMX_TASK_CORE;         // Core to pin the task to, or tskNO_AFFINITY
+  UBaseType_t priority = WDMX_TASK_PRIORITY;
+  uint32_t stackSize = WDMX_TASK_STACK_SIZE;  // In bytes
+};
+
 inline wdmxID_t operator++ (wdmxID_t &id) {
   id = static_cast<wdmxID_t>((static_cast<int>(id) + 1) % 8);
   return id;
 }
 
+/*
+ * Wait-free single-producer/single-consumer queue with a capacity chosen at runtime.
+ *
+ * One task may call reserve()/commit() or push(), and one other task may call pop(). Neither side ever blocks:
+ * the producer gets nullptr from reserve() (or false from push()) if the queue is full.
+ */
+template <typename T>
+class wdmxSPSCQueue
+{
+  public:
+    ~wdmxSPSCQueue() { end(); };
+
+    // Allocate the queue. With preferPSRAM, use PSRAM if the board has it, and fall back to internal RAM otherwise.
+    bool begin(size_t capacity, bool preferPSRAM = false) {
+      size_t bytes = (capacity + 1) * sizeof(T); // One slot always stays empty to tell "full" from "empty"
+      end();
+      if (preferPSRAM) {
+        _slots = (T*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      }
+      if (_slots == nullptr) {
+        _slots = (T*)heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+      }
+      if (_slots == nullptr) {
+        return(false);
+      }
+      _size = capacity + 1;
+      _head.store(0);
+      _tail.store(0);
+      return(true);
+    };
+
+    void end() {
+      heap_caps_free(_slots);
+      _slots = nullptr;
+      _size = 0;
+    };
+
+    bool isAllocated() const { return (_slots != nullptr); };
+    size_t capacity() const { return ((_size > 0) ? _size - 1 : 0); };
+
+    // Producer: return the slot to fill next, or nullptr if the queue is full. The slot is queued by commit().
+    T* reserve() {
+      size_t head = _head.load(std::memory_order_relaxed);
+      if ((_slots == nullptr) || (_next(head) == _tail.load(std::memory_order_acquire))) {
+        return(nullptr);
+      }
+      return(&_slots[head]);
+    };
+
+    void commit() { _head.store(_next(_head.load(std::memory_order_relaxed)), std::memory_order_release); };
+
+    bool push(const T& item) {
+      T* slot = reserve();
+      if (slot == nullptr) {
+        return(false);
+      }
+      *slot = item;
+      commit();
+      return(true);
+    };
+
+    // Consumer
+    bool pop(T& item) {
+      size_t tail = _tail.load(std::memory_order_relaxed);
+      if ((_slots == nullptr) || (tail == _head.load(std::memory_order_acquire))) {
+        return(false);
+      }
+      item = _slots[tail];
+      _tail.store(_next(tail), std::memory_order_release);
+      return(true);
+    };
+
+    bool isFull() const { return ((_slots != nullptr) && (_next(_head.load(std::memory_order_acquire)) == _tail.load(std::memory_order_acquire))); };
+
+  private:
+    size_t _next(size_t index) const { return ((index + 1 == _size) ? 0 : index + 1); };
+
+    T* _slots = nullptr;
+    size_t _size = 0;
+    std::atomic<size_t> _head{0};  // Next slot the producer writes
+    std::atomic<size_t> _tail{0};  // Next slot the consumer reads
+};
+
 class WirelessDMXReceiver
 {
   public:
@@ -52,54 +201,446 @@ class WirelessDMXReceiver
       uint16_t highestChannelID; // Highest channel ID in the universe (not necessarily in this packet). Basically, highestChannelID + 1 = numChannels.
       uint8_t dmxData[WDMX_PAYLOAD_SIZE-WDMX_HEADER_SIZE];
     };
-    
-    WirelessDMXReceiver(int cePin, int csnPin, int statusLEDPin);
 
+    struct wdmxCaptureRecord {
+      int64_t timestamp;         // esp_timer_get_time() when the packet was read from the radio
+      uint8_t channel;           // RF channel the packet was received on
+      uint8_t ID;                // Unit ID the packet was received for
+      wdmxReceiveBuffer packet;
+    };
+
+    struct wdmxStats {
+      uint32_t rxCount;            // Number of valid packets received
+      uint32_t rxInvalid;          // Number of packets with invalid header
+      uint32_t rxOverruns;         // Number of times RF24 returned FifoFull when we were processing a packet
+      uint32_t rxSeqErrors;        // Number of times we detected a gap in sequence numbers
+      uint32_t frameQueueOverruns; // Number of frames dropped because the frame queue was full
+      uint32_t framesWithheld;     // Number of times WDMX_COMPLETE_ALL_SLOTS held back a frame because a slot was missing
+    };
+
+    struct wdmxHistogram {
+      uint32_t buckets[WDMX_HISTOGRAM_BUCKETS]; // Bucket n counts samples of [2^n, 2^(n+1)) us. Bucket 0 also counts 0us.
+      uint32_t count;
+      uint32_t min;                // Microseconds
+      uint32_t max;                // Microseconds
+      uint64_t sum;                // Microseconds
+    };
+
+    struct wdmxFrame {
+      int64_t timestamp;         // esp_timer_get_time() when the frame was published
+      uint32_t generation;       // frameGeneration() of this frame
+      uint16_t channelCount;     // getChannelCount() when the frame was published. data beyond that is undefined.
+      uint8_t data[DMX_BUFSIZE];
+    };
+
+    /*
+     * Use an nRF24L01 on the given pins. spiBus and spiSpeed select the SPI bus and clock, see WirelessDMXRF24Radio.
+     *
+     * With either constructor: if irqPin is given, the receive task sleeps until the radio pulls its IRQ line low
+     * instead of continuously polling the radio over SPI.
+     */
+    WirelessDMXReceiver(int cePin, int csnPin, int statusLEDPin, int irqPin = -1,
+                        uint32_t spiSpeed = WDMX_SPI_SPEED, SPIClass* spiBus = nullptr);
+
+    /*
+     * Use any WirelessDMXRadio implementation, e.g. WirelessDMXMockRadio. The radio must outlive the receiver.
+     */
+    WirelessDMXReceiver(WirelessDMXRadio& radio, int statusLEDPin = 0, int irqPin = -1);
+    ~WirelessDMXReceiver();
+
+    /*
+     * RF24 address that a transmitter with the given unit ID uses on the given channel.
+     */
+    static uint64_t getAddress(unsigned int channel, wdmxID_t ID);
+
+    /*
+     * Remember the channel and unit ID of the last lock in NVS, and probe it first on the next begin(). Enabled by
+     * default. Use a different namespace for every receiver if there is more than one.
+     */
+    void setLockPersistence(bool enable, const char* nvsNamespace = WDMX_NVS_NAMESPACE) { _persistLock = enable; _nvsNamespace = nvsNamespace; };
+
+    /*
+     * Select the scan strategy. WDMX_SCAN_FAST only waits for a packet on channels where the radio detects a
+     * carrier, which makes a scan over empty channels about ten times faster, but may miss very weak transmitters.
+     */
+    void setScanMode(wdmxScanMode_t mode) { _scanMode = mode; };
+
+    /*
+     * If no valid packet arrives for timeoutMs, mark the receiver unlocked and re-scan from within the receive
+     * task, starting at the last known channel and moving outwards. 0 disables signal loss detection. The loss
+     * policy determines what readers see while we are unlocked.
+     */
+    void setSignalTimeout(unsigned int timeoutMs) { _signalTimeout = timeoutMs; };
+    void setLossPolicy(wdmxLossPolicy_t policy) { _lossPolicy = policy; };
+
+    /*
+     * With WDMX_COMPLETE_ALL_SLOTS, a frame in which a slot (a payload of 28 channels) was lost is not published
+     * when the last slot arrives. The receiver keeps collecting, and publishes as soon as every slot of the
+     * universe arrived at least once since the previous frame - usually when the lost slot comes around again. If
+     * that takes longer than maxWithholdMs, the frame is published anyway.
+     */
+    void setCompletionPolicy(wdmxCompletionPolicy_t policy, unsigned int maxWithholdMs = WDMX_WITHHOLD_MAX_MS) { _completionPolicy = policy; _maxWithhold = maxWithholdMs; };
+
+    /*
+     * Save power while no transmitter can be found. Once the receiver has been unlocked for idleAfterMs, it only
+     * probes one channel per intervalMs, and sleeps in between while the radio keeps listening on the last probed
+     * channel. If a packet arrives there, the receiver wakes up (through the IRQ pin, if there is one) and probes
+     * the channel right away; full-rate scanning resumes when a transmitter is found.
+     *
+     * With lightSleep, the whole chip enters light sleep between probes, waking up on the radio IRQ line (if
+     * configured) or after intervalMs. This stops both cores, so only use it if nothing else needs to run. Without
+     * it, the receive task blocks, which lets FreeRTOS idle (and enter automatic light sleep, if power management
+     * is enabled in the SDK configuration). intervalMs must be well below the task watchdog timeout. 0 disables
+     * idle mode, which is the default; receivers in a WirelessDMXReceiverGroup never enter it. Must be called
+     * before begin().
+     */
+    void setIdleMode(unsigned int idleAfterMs, unsigned int intervalMs = WDMX_IDLE_INTERVAL_MS, bool lightSleep = false) { _idleAfter = idleAfterMs; _idleInterval = intervalMs; _lightSleep = lightSleep; };
+
+    /*
+     * Select the core, priority and stack size of the receive task. Must be called before begin(). If the
+     * application uses WiFi heavily, consider moving the task to core 1; mind that the Arduino loop task runs there.
+     */
+    void setTaskConfig(const wdmxTaskConfig& config) { _taskConfig = config; };
+
+    /*
+     * Smallest amount of free stack the receive task had so far, in bytes. Use it to size the stack in
+     * setTaskConfig(). Returns 0 before begin().
+     */
+    size_t stackHighWaterMark() const { return(_dmxReceiveTask ? uxTaskGetStackHighWaterMark(_dmxReceiveTask) : 0); };
+
+    /*
+     * Start the radio, scan until a transmitter is found, and start the receive task. If given, scanCallback is
+     * invoked between probes.
+     */
     void begin(wdmxID_t ID=AUTO);
     void begin(wdmxID_t ID, std::function<void()> scanCallback);
 
-    uint8_t getValue(unsigned int address) const { return (dmxBuffer[address-1]); };
-    void getValues(unsigned int startAddress, unsigned int length, void* buffer) const { memcpy(buffer, &dmxBuffer[startAddress-1], length); };
+    /*
+     * Start the radio and the receive task, and return right away. The receive task scans for the transmitter,
+     * starting with the last known channel; use isLocked(), onLockChange() or waitForLock() to find out when it
+     * has found one.
+     */
+    void beginAsync(wdmxID_t ID=AUTO);
+
+    /*
+     * Stop the receive task started by begin() or beginAsync(), e.g. before deleting the receiver. Waits for the
+     * task to finish its current pass. Receivers added to a WirelessDMXReceiverGroup are not affected.
+     */
+    void end();
+
+    /*
+     * Wait until the receiver is locked, for up to timeoutMs. Returns true if it is locked. May be called from any
+     * task, also before begin() or beginAsync().
+     */
+    bool waitForLock(uint32_t timeoutMs = WDMX_WAIT_FOREVER);
+
+    /*
+     * Register a callback that is invoked whenever the receiver gains or loses the signal. Runs on the receive
+     * task (or, during the blocking begin(), on the caller's task). Must be called before begin().
+     */
+    void onLockChange(std::function<void(bool locked)> callback) { _lockCallback = callback; };
+
+    /*
+     * Feed a packet into the decoder as if it had been received by the radio. Meant for replaying captures and for
+     * benchmarking without RF hardware: do not use this after begin(), as the receive task is the only writer then.
+     */
+    void processPacket(const wdmxReceiveBuffer& rxBuf);
+
+    /*
+     * Select how received data is made available. Must be called before begin(). In WDMX_BUFFER_TRIPLE mode,
+     * dmxBuffer is not updated; use getValue(), getValues() or getFrame() instead.
+     */
+    void setBufferMode(wdmxBufferMode_t mode) { _bufferMode = mode; _resetBuffers(); };
+
+    uint8_t getValue(unsigned int address) const { return (getFrame()[address-1]); };
+    void getValues(unsigned int startAddress, unsigned int length, void* buffer) const { memcpy(buffer, &getFrame()[startAddress-1], length); };
+    const uint8_t* getFrame() const { return (_frontBuffer.load(std::memory_order_acquire)); }; // Most recent complete frame
+
+    /*
+     * Number of frames published since begin(). Generation 0 means that no frame has been received yet.
+     */
+    uint32_t frameGeneration() const { return (_frameGeneration.load(std::memory_order_acquire)); };
+
+    /*
+     * Number of channels in the universe, as reported by the transmitter. Channels beyond that read as zero.
+     * DMX_BUFSIZE until the first packet arrived.
+     */
+    unsigned int getChannelCount() const { return (_channelCount.load(std::memory_order_relaxed)); };
+
+    /*
+     * Per-slot freshness. Slot n holds channels 28*n+1 to 28*n+28. slotAge() is the time in ms since the slot was
+     * last received (with WDMX_HOUSEKEEPING_MS granularity), or ULONG_MAX if it never was; channelAge() is the
+     * same, by channel address. slotLosses() counts how often the slot was missing from the sequence.
+     */
+    unsigned long slotAge(unsigned int slot) const;
+    unsigned long channelAge(unsigned int address) const { return (slotAge((address-1) / WDMX_SLOT_CHANNELS)); };
+    uint32_t slotLosses(unsigned int slot) const { return ((slot < WDMX_SLOT_COUNT) ? _slotLosses[slot].load(std::memory_order_relaxed) : 0); };
+
+    /*
+     * Counts published frames in which at least one channel changed. Unlike fetchAndClearDirty(), any number of
+     * readers can use this to find out whether there is anything new to send.
+     */
+    uint32_t changeGeneration() const { return (_changeGeneration.load(std::memory_order_acquire)); };
+
+    /*
+     * Copy the first len channels of the most recent frame into dst.
+     *
+     * If gen is given and *gen already holds the current generation, returns false without copying. Otherwise,
+     * copies the frame, stores its generation in *gen and returns true. The copy is retried if the receive task
+     * overwrote the buffer while we were reading it, so dst never holds a torn frame in WDMX_BUFFER_TRIPLE mode.
+     * In WDMX_BUFFER_DIRECT mode, this only detects frames completing during the copy.
+     */
+    bool readSnapshot(uint8_t* dst, size_t len, uint32_t* gen = nullptr) const;
+
+    /*
+     * Copy the bitmap of channels that changed since the last call into bitmap, and clear it. Bit (n % 32) of
+     * bitmap[n / 32] is set if channel n+1 changed. Returns true if any channel changed.
+     */
+    bool fetchAndClearDirty(uint32_t bitmap[WDMX_DIRTY_WORDS]);
+
+    /*
+     * Register a callback that is invoked once per published frame in which any channel changed. The range covers
+     * all changed channels of that frame; startChannel is 1-based like getValue(). The callback runs on the receive
+     * task and must return quickly.
+     */
+    void onChange(std::function<void(unsigned int startChannel, unsigned int length)> callback) { _changeCallback = callback; };
+
+    /*
+     * Register a callback that is invoked once for every published frame, changed or not, after the front buffer
+     * was updated. Meant for output stages such as WirelessDMXOutput that want to start sending as soon as a
+     * universe is complete; usually, the callback just notifies another task. Runs on the receive task like
+     * onChange(). Must be called before begin(). Returns the callback's index, or -1 if WDMX_MAX_FRAME_CALLBACKS
+     * are registered already.
+     */
+    int addFrameCallback(std::function<void()> callback);
+
+    /*
+     * Stop invoking the frame callback with the given index, e.g. before deleting the task it notifies. Returns
+     * once the callback is no longer running, so it must not be called from a callback. The index is not reused.
+     */
+    void removeFrameCallback(int index);
+
+    /*
+     * Have the receive task copy channels startAddress..startAddress+length-1 into destination (e.g. a packed
+     * struct holding a fixture's channels) whenever a packet holding any of them arrives. Must be called before
+     * begin(). Returns the subscription index, or -1 if the range is invalid or WDMX_MAX_SUBSCRIPTIONS are
+     * registered already.
+     *
+     * Channels are written as packets arrive, independently of frames. subscriptionGeneration() is incremented
+     * after every write into destination; if a range spans two packets, a reader may see one of them updated and
+     * the other not yet. It returns 0 for an invalid index.
+     */
+    int subscribe(unsigned int startAddress, unsigned int length, void* destination);
+    uint32_t subscriptionGeneration(int index) const { return (((index >= 0) && (index < (int)_subscriptionCount)) ? _subscriptions[index].generation.load(std::memory_order_acquire) : 0); };
+
+    /*
+     * If enabled, payloads that hold no subscribed channel are not copied into the DMX buffers at all. getValue(),
+     * readSnapshot() and the outputs then only see subscribed channels. Must be called before begin().
+     */
+    void setSubscribedOnly(bool enable) { _subscribedOnly = enable; };
+
+    /*
+     * Queue every published frame for a consumer task, in addition to updating the front buffer. Must be called
+     * before begin(). Returns false if the queue could not be allocated. If the consumer falls behind, new frames
+     * are dropped and counted in frameQueueOverruns().
+     */
+    bool enableFrameQueue(size_t depth) { return (_frameQueue.begin(depth)); };
+    bool popFrame(wdmxFrame& frame) { return (_frameQueue.pop(frame)); };
+    unsigned int frameQueueOverruns() const { return (_publishedStats.frameQueueOverruns); };
     wdmxID_t getId() const { return (_ID); };
     unsigned int getChannel() const { return (_channel); };
     bool isLocked() const { return (_locked); };
-    unsigned int rxCount() const { return (_rxCount); };
-    unsigned int rxInvalid() const { return (_rxInvalid); };
-    unsigned int rxOverruns() const { return (_rxOverruns); };
-    unsigned int rxSeqErrors() const { return (_rxSeqErrors); };
+    bool isIdle() const { return (_idle); };                          // In idle mode, see setIdleMode()
+    unsigned long idleMillis() const { return (_idleTime); };          // Total time spent sleeping in idle mode
+    unsigned long lastReacquireMillis() const { return (_lastReacquire); }; // Time from losing the signal (or begin()) to the last lock
+
+    unsigned long lastPacketMillis() const { return (_lastPacketTime); }; // millis() of the last valid packet
+    unsigned int rxCount() const { return (_publishedStats.rxCount); };
+    unsigned int rxInvalid() const { return (_publishedStats.rxInvalid); };
+    unsigned int rxOverruns() const { return (_publishedStats.rxOverruns); };
+    unsigned int rxSeqErrors() const { return (_publishedStats.rxSeqErrors); };
+
+    /*
+     * Consistent snapshot of all counters. Counters are published by the receive task every WDMX_HOUSEKEEPING_MS,
+     * so they may lag behind by that much.
+     */
+    void getStats(wdmxStats& stats) const;
 
     uint8_t dmxBuffer[DMX_BUFSIZE];
     bool debug;
 
-    void startCapture();
+    /*
+     * Record received packets. The capture buffer is allocated on the first startCapture(), preferring PSRAM,
+     * and released once printCapture() emptied it after stopCapture(), or by clearCapture(). Once the buffer is
+     * full, further packets are not recorded. Returns false if the buffer could not be allocated.
+     */
+    bool startCapture(size_t depth = WDMX_CAPTURE_DEPTH);
     void stopCapture();
+    void clearCapture();
     bool isCaptureBufferFull();
     void printCapture();
 
+    /*
+     * Write captured packets to out in pcap format (link type WDMX_PCAP_LINKTYPE), for analysis on a PC. The pcap
+     * header is written on the first call after startCapture(). Call this repeatedly while the capture is running
+     * to record sessions of any length; returns the number of packets written. Like printCapture(), this releases
+     * the capture buffer once a stopped capture has been written completely.
+     */
+    size_t streamCapture(Print& out, size_t maxPackets = SIZE_MAX);
+
+    /*
+     * Latency and jitter instrumentation, only available if compiled with WDMX_INSTRUMENTATION. Histograms are
+     * updated by the receive task without locking, so a copy may be off by a sample or two.
+     */
+    bool getHistogram(wdmxHistogramID_t id, wdmxHistogram& histogram) const;
+    int64_t lastPacketTimestamp() const;  // esp_timer_get_time() at arrival of the last valid packet
+    int64_t lastFrameTimestamp() const;   // esp_timer_get_time() when the last frame was published
+    void resetHistograms();
+    void printHistograms();
+
   private:
+    friend class WirelessDMXReceiverGroup;
+
     bool _scanChannel();
+    void _startProbe();
+    int _pollProbe();
     void _scanNext();
+    void _nextScanID();
+    void _relockNext();
+    void _startRelock(unsigned int origin);
+    bool _idleDue();
+    bool _idleWait();
+    void _signalLost();
+    void _housekeeping(unsigned long now);
+    void _publishStats();
+    wdmxID_t _pairedID();
+    bool _probeLastLock();
+    bool _loadLastLock(unsigned int& channel, wdmxID_t& ID);
+    void _saveLastLock();
+    unsigned int _drainFifo();
+    void _handlePacket(const wdmxReceiveBuffer& rxBuf);
+    void _resetBuffers();
+    void _countLostSlots(unsigned int expected, unsigned int received, unsigned int lastSlot);
+    bool _frameComplete(unsigned int lastSlot);
+    void _setChannelCount(unsigned int count);
+    void _deliver(unsigned int start, const uint8_t* data, size_t len, uint32_t subscribers);
+    void _writeChannels(unsigned int start, const uint8_t* data, size_t len);
+    void _publishFrame();
+    void _setup(wdmxID_t ID);
+    void _setupAsync(wdmxID_t ID);
+    void _startTask();
+    void _lockChanged();
+    void _service();
+    void _attachIRQ();
     void _dmxReceiveLoop();
 
     static void _startDMXReceiveThread(void*);
-    uint64_t _getAddress(unsigned int channel, wdmxID_t ID);
+    static void _irqHandler(void*);
+    void _init(int irqPin);
 
     wdmxID_t _configID;
     wdmxID_t _ID;
     unsigned int _channel;
-    bool _locked;
+    bool _locked = false;
+    unsigned int _signalTimeout = WDMX_SIGNAL_TIMEOUT_MS;
+    wdmxLossPolicy_t _lossPolicy = WDMX_LOSS_HOLD;
+    unsigned long _lastPacketTime = 0;
+    unsigned int _relockOrigin = 0;   // Channel we lost the signal on
+    unsigned int _relockStep = 0;     // Position in the outward search from _relockOrigin
+    bool _probing = false;            // A probe started by _startProbe() is running
+    unsigned int _idleAfter = 0;      // See setIdleMode()
+    unsigned int _idleInterval = WDMX_IDLE_INTERVAL_MS;
+    bool _lightSleep = false;
+    volatile bool _idle = false;
+    unsigned long _unlockedSince = 0; // millis() when we started searching for a transmitter
+    volatile unsigned long _idleTime = 0;
+    volatile unsigned long _lastReacquire = 0;
+    bool _irqAttached = false;
+    volatile bool _taskRunning = false;   // Our own receive task is running
+    volatile bool _stopRequested = false; // Asks the receive task to exit, see end()
+    StaticEventGroup_t _lockEventsBuffer;
+    EventGroupHandle_t _lockEvents;            // WDMX_EVENT_LOCKED is set while locked
+    std::function<void(bool)> _lockCallback;
+    bool _probeCarrier;               // The running probe has detected a carrier on the channel
+    unsigned long _probeStarted;      // micros() when the running probe started
+    wdmxScanMode_t _scanMode = WDMX_SCAN_EXHAUSTIVE;
+    bool _persistLock = true;
+    const char* _nvsNamespace = WDMX_NVS_NAMESPACE;
+
+    wdmxStats _stats = {};                      // Only ever touched by the receive task
+    alignas(32) wdmxStats _publishedStats = {}; // Copy of _stats for everybody else, see _publishStats()
+    std::atomic<uint32_t> _statsSequence;       // Odd while _publishedStats is being updated
+    unsigned long _lastHousekeeping = 0;
+    uint32_t _housekeepingRxCount = 0;
+    uint8_t _prevPayloadID = 0;
+    bool _firstFrame = true;
+    std::atomic<uint16_t> _channelCount{DMX_BUFSIZE};  // Size of the universe, from highestChannelID
+    unsigned int _fullSeeds = 0;      // Number of publishes that still need to seed the entire back buffer
+    wdmxCompletionPolicy_t _completionPolicy = WDMX_COMPLETE_LAST_SLOT;
+    unsigned int _maxWithhold = WDMX_WITHHOLD_MAX_MS;
+    uint32_t _slotsReceived = 0;      // Bitmap of slots received since the last publish
+    bool _withheld = false;           // We skipped publishing a frame because a slot was missing
+    unsigned long _lastPublish = 0;   // millis() of the last publish
+    std::atomic<uint32_t> _slotUpdated[WDMX_SLOT_COUNT];  // millis() when each slot was last received, 0 if never
+    std::atomic<uint32_t> _slotLosses[WDMX_SLOT_COUNT];   // Number of times each slot was lost
+
+    wdmxBufferMode_t _bufferMode = WDMX_BUFFER_DIRECT;
+    uint8_t _frames[3][DMX_BUFSIZE];            // Triple buffer. The receive task only ever writes _frames[_backIndex].
+    unsigned int _backIndex = 0;
+    uint8_t* _backBuffer;                       // Buffer that the receive task is currently writing to
+    std::atomic<const uint8_t*> _frontBuffer;   // Buffer that readers are reading from
+    std::atomic<uint32_t> _frameGeneration;     // Incremented whenever a frame is published
+    std::atomic<uint32_t> _changeGeneration{0}; // Incremented whenever a frame with changed channels is published
+    bool _framePending = false;                 // Back buffer holds data that has not been published yet
+
+    uint32_t _frameDirty[WDMX_DIRTY_WORDS];     // Channels changed in the frame currently being received
+    std::atomic<uint32_t> _dirty[WDMX_DIRTY_WORDS]; // Channels changed since the last fetchAndClearDirty()
+    int _frameChangeFirst = -1;                 // Lowest (0-based) channel changed in the current frame, -1 if none
+    int _frameChangeLast = -1;                  // Highest (0-based) channel changed in the current frame
+    std::function<void(unsigned int, unsigned int)> _changeCallback;
+    std::function<void()> _frameCallbacks[WDMX_MAX_FRAME_CALLBACKS];
+    std::atomic<bool> _frameCallbackActive[WDMX_MAX_FRAME_CALLBACKS];
+    std::atomic<bool> _runningFrameCallbacks;  // Set while the receive task invokes the frame callbacks
+    unsigned int _frameCallbackCount = 0;
+
+    struct wdmxSubscription {
+      unsigned int start;           // 0-based
+      unsigned int length;
+      uint8_t* destination;
+      std::atomic<uint32_t> generation;
+    };
+    wdmxSubscription _subscriptions[WDMX_MAX_SUBSCRIPTIONS];
+    unsigned int _subscriptionCount = 0;
+    uint32_t _slotSubscribers[WDMX_SLOT_COUNT] = {};  // Per slot, bitmap of the subscriptions that overlap it
+    uint32_t _allSubscribers = 0;
+    bool _subscribedOnly = false;
 
-    unsigned int _rxCount = 0;     // Number of frames received
-    unsigned int _rxInvalid = 0;   // Number of frames with invalid header
-    unsigned int _rxOverruns = 0;  // Number of times RF24 returned FifoFull when we were processing a frame 
-    unsigned int _rxSeqErrors = 0; // Number of times we detected a gap in sequence numbers
-    int _statusLEDPin;
-    RF24 _radio;
-    TaskHandle_t _dmxReceiveTask;
+    wdmxSPSCQueue<wdmxFrame> _frameQueue;
+    WirelessDMXStatusLED _statusLED;
+    int _irqPin;
+    WirelessDMXRadio* _radio;
+    WirelessDMXRF24Radio* _rf24Radio = nullptr;  // Owned by us if we were constructed from pin numbers
+    wdmxTaskConfig _taskConfig;
+    TaskHandle_t _dmxReceiveTask = nullptr;
 
-    bool _capture;
 #ifdef WDMX_CAPTURE
-    RingBuf<wdmxReceiveBuffer, 2048> _captureBuffer;
+    void _releaseCapture();
+
+    std::atomic<bool> _capture;
+    std::atomic<bool> _captureBusy;   // Set while the receive task pushes into _captureBuffer
+    wdmxSPSCQueue<wdmxCaptureRecord> _captureBuffer;
+    bool _captureHeaderPending = false;
+#endif
+
+#ifdef WDMX_INSTRUMENTATION
+    void _recordSample(wdmxHistogramID_t id, int64_t us);
+
+    wdmxHistogram _histograms[WDMX_HIST_COUNT];
+    std::atomic<bool> _histogramReset;
+    volatile int64_t _irqTimestamp = 0;   // Set by the IRQ handler
+    int64_t _packetArrival = 0;           // Arrival time of the packet being processed
+    int64_t _lastPacketTimestamp = 0;
+    int64_t _lastFrameTimestamp = 0;
 #endif
 };
 
@@ -0,0 +1,81 @@
+/*
+  WirelessDMXReceiverGroup.cpp - Receive several Wireless DMX universes from a single task
+  Released into the public domain.
+*/
+
+#include "WirelessDMXReceiverGroup.h"
+#include <esp_task_wdt.h>
+
+/*
+ * Add a receiver to the group, to be started with the given unit ID. Must be called before begin().
+ * Returns false if the group is full.
+ */
+bool WirelessDMXReceiverGroup::add(WirelessDMXReceiver& receiver, wdmxID_t ID)
+{
+  if ((_count >= WDMX_GROUP_MAX_RECEIVERS) || (_receiveTask != nullptr)) {
+    return(false);
+  }
+  _receivers[_count] = &receiver;
+  _IDs[_count] = ID;
+  _count++;
+  return(true);
+}
+
+/*
+ * Start all radios and the receive task.
+ */
+void WirelessDMXReceiverGroup::begin()
+{
+  for (size_t i = 0; i < _count; i++) {
+    _receivers[i]->_idleAfter = 0; // Sleeping in the shared task would stall the other receivers
+    _receivers[i]->_setupAsync(_IDs[i]);
+  }
+
+  xTaskCreatePinnedToCore(
+    _startReceiveThread,        /* Function to implement the task */
+    "DMX Group Receive Thread", /* Name of the task */
+    _taskConfig.stackSize,      /* Stack size in bytes (not words, on ESP32) */
+    this,                       /* Task input parameter */
+    _taskConfig.priority,       /* Priority of the task */
+    &_receiveTask,              /* Task handle. */
+    _taskConfig.core            /* Core where the task should run */
+  );
+  esp_task_wdt_add(_receiveTask);
+}
+
+void WirelessDMXReceiverGroup::_startReceiveThread(void* _this)
+{
+  ((WirelessDMXReceiverGroup*)_this)->_receiveLoop();
+}
+
+void WirelessDMXReceiverGroup::_receiveLoop()
+{
+  // Every receiver's IRQ handler notifies this task
+  for (size_t i = 0; i < _count; i++) {
+    _receivers[i]->_attachIRQ();
+  }
+
+  unsigned long lastYield = millis();
+
+  while (true) {
+    bool idle = true;
+
+    for (size_t i = 0; i < _count; i++) {
+      _receivers[i]->_service();
+      // Keep polling while any receiver is scanning, or has no IRQ line to wake us up
+      if (!_receivers[i]->_locked || (_receivers[i]->_irqPin < 0)) {
+        idle = false;
+      }
+    }
+    if (idle) {
+      /*
+       * All radios are locked and signal packets through their IRQ line. _service() drained all FIFOs, so every
+       * IRQ line is high again and the next packet on any of them wakes us up.
+       */
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WDMX_IRQ_TIMEOUT_MS));
+    } else if (millis() - lastYield >= WDMX_POLL_YIELD_MS) {
+      vTaskDelay(1);
+      lastYield = millis();
+    }
+  }
+}
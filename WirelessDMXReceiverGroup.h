@@ -0,0 +1,53 @@
+/*
+  WirelessDMXReceiverGroup.h - Receive several Wireless DMX universes from a single task
+  Released into the public domain.
+*/
+
+#ifndef WirelessDMXReceiverGroup_h
+#define WirelessDMXReceiverGroup_h
+
+#include "Arduino.h"
+#include "WirelessDMXReceiver.h"
+
+#define WDMX_GROUP_MAX_RECEIVERS        4   // Maximum number of receivers in a group
+
+/*
+ * Services several WirelessDMXReceivers - one per radio - from a single receive task, instead of one task per
+ * receiver. The task drains the RX FIFO of every radio in turn; with IRQ pins configured, it sleeps until any of
+ * the radios signals a packet.
+ *
+ * The radios may share one SPI bus, as long as each has its own CSN pin. Scanning happens in the group's task,
+ * channel by channel and interleaved across all receivers, so begin() does not block until the receivers are
+ * locked; use isLocked() on the individual receivers. If lock persistence is enabled, give every receiver its own
+ * NVS namespace.
+ *
+ * Receivers added to a group must not be started with their own begin().
+ */
+class WirelessDMXReceiverGroup
+{
+  public:
+    bool add(WirelessDMXReceiver& receiver, wdmxID_t ID = AUTO);
+    void begin();
+
+    /*
+     * Select the core, priority and stack size of the group's receive task. Must be called before begin().
+     * The task configuration of the individual receivers is not used.
+     */
+    void setTaskConfig(const wdmxTaskConfig& config) { _taskConfig = config; };
+    size_t stackHighWaterMark() const { return(_receiveTask ? uxTaskGetStackHighWaterMark(_receiveTask) : 0); };
+
+    size_t size() const { return(_count); };
+    WirelessDMXReceiver& operator[](size_t index) { return(*_receivers[index]); };
+
+  private:
+    void _receiveLoop();
+    static void _startReceiveThread(void*);
+
+    WirelessDMXReceiver* _receivers[WDMX_GROUP_MAX_RECEIVERS];
+    wdmxID_t _IDs[WDMX_GROUP_MAX_RECEIVERS];
+    size_t _count = 0;
+    wdmxTaskConfig _taskConfig;
+    TaskHandle_t _receiveTask = nullptr;
+};
+
+#endif
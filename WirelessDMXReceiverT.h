@@ -0,0 +1,441 @@
+/*
+  WirelessDMXReceiverT.h - Wireless DMX receiver specialized for a fixed configuration at compile time
+  Released into the public domain.
+*/
+
+#ifndef WirelessDMXReceiverT_h
+#define WirelessDMXReceiverT_h
+
+#if __cplusplus < 201703L
+#error "WirelessDMXReceiverT requires C++17 (arduino-esp32 3.x, or build with -std=gnu++17)"
+#endif
+
+#include "Arduino.h"
+#include <esp_task_wdt.h>
+#include <esp_timer.h>
+#include <type_traits>
+#include "WirelessDMXReceiver.h"
+
+/*
+ * Default configuration for WirelessDMXReceiverT. Derive from it and override what you need:
+ *
+ *   struct MyConfig : wdmxDefaultConfig {
+ *     static constexpr wdmxID_t ID = BLUE;
+ *     static constexpr bool stats = false;
+ *   };
+ *   WirelessDMXRF24Radio radio(RF24_PIN_CE, RF24_PIN_CSN);
+ *   WirelessDMXReceiverT<96, MyConfig> receiver(radio, RF24_PIN_IRQ);
+ */
+struct wdmxDefaultConfig {
+  static constexpr wdmxID_t ID = RED;                         // Unit ID of the transmitter. AUTO is not supported.
+  static constexpr bool checkMagic = true;                    // Drop packets with an unexpected magic number
+  static constexpr bool stats = true;                         // Count invalid packets, overruns and sequence errors
+  static constexpr bool statusLED = true;                     // Drive a status LED (see WirelessDMXStatusLED)
+  static constexpr bool tripleBuffer = true;                  // Publish complete frames atomically (WDMX_BUFFER_TRIPLE)
+  static constexpr unsigned int signalTimeoutMs = WDMX_SIGNAL_TIMEOUT_MS;  // 0 disables signal loss detection
+  static constexpr bool capture = false;                      // Support startCapture() (see WirelessDMXReceiver)
+  static constexpr bool debug = false;                        // Print scan progress
+};
+
+/*
+ * A receiver for a transmitter with a unit ID, universe size and feature set that are known at compile time. It
+ * offers the core of the WirelessDMXReceiver reading API; features that are disabled in Config are compiled out
+ * of the receive path, and buffers are sized for Channels.
+ *
+ * The universe may be smaller or larger than Channels: frames end with the last payload of the universe (as
+ * reported in the packets) or the one holding channel Channels, whichever comes first, and channels beyond
+ * Channels are dropped. Radio is the radio class;
+ * with the default WirelessDMXRF24Radio, radio calls are not virtual. With Config::capture, received packets can
+ * be recorded as by WirelessDMXReceiver; the frame queue, onChange() and its other optional features are not
+ * available here.
+ */
+template <unsigned int Channels = DMX_BUFSIZE, typename Config = wdmxDefaultConfig, typename Radio = WirelessDMXRF24Radio>
+class WirelessDMXReceiverT
+{
+  static_assert((Channels > 0) && (Channels <= DMX_BUFSIZE), "Channels must be 1..512");
+  static_assert(Config::ID != AUTO, "WirelessDMXReceiverT needs a fixed unit ID");
+
+  public:
+    using wdmxReceiveBuffer = WirelessDMXReceiver::wdmxReceiveBuffer;
+    using wdmxCaptureRecord = WirelessDMXReceiver::wdmxCaptureRecord;
+
+    static constexpr unsigned int channels = Channels;
+    static constexpr unsigned int lastSlot = (Channels - 1) / WDMX_SLOT_CHANNELS;   // Last payloadID we store
+    static constexpr unsigned int buffers = Config::tripleBuffer ? 3 : 1;
+
+    WirelessDMXReceiverT(Radio& radio, int irqPin = -1, int statusLEDPin = 0)
+      : _radio(radio), _irqPin(irqPin), _statusLED(statusLEDPin)
+    {
+      memset(_frames, 0x00, sizeof(_frames));
+      _backBuffer = _frames[0];
+      _frontBuffer.store(_frames[buffers - 1]);
+    };
+
+    void setTaskConfig(const wdmxTaskConfig& config) { _taskConfig = config; };
+
+    /*
+     * Start the radio, scan for the transmitter (blocking), and start the receive task.
+     */
+    bool begin()
+    {
+      if constexpr (Config::statusLED) {
+        _statusLED.begin(*this);
+      }
+      if (!_radio.begin()) {
+        return(false);
+      }
+      if (_irqPin >= 0) {
+        _radio.maskIRQ(true, true, false);
+      }
+      _startRelock(0);
+      while (!_locked) {
+        _relockNext();
+      }
+
+      xTaskCreatePinnedToCore(
+        _startReceiveThread,      /* Function to implement the task */
+        "DMX Receive Thread",     /* Name of the task */
+        _taskConfig.stackSize,    /* Stack size in bytes (not words, on ESP32) */
+        this,                     /* Task input parameter */
+        _taskConfig.priority,     /* Priority of the task */
+        &_receiveTask,            /* Task handle. */
+        _taskConfig.core          /* Core where the task should run */
+      );
+      esp_task_wdt_add(_receiveTask);
+      return(true);
+    };
+
+    uint8_t getValue(unsigned int address) const { return (getFrame()[address-1]); };
+    const uint8_t* getFrame() const { return (_frontBuffer.load(std::memory_order_acquire)); };
+    uint32_t frameGeneration() const { return (_frameGeneration.load(std::memory_order_acquire)); };
+
+    /*
+     * See WirelessDMXReceiver::readSnapshot().
+     */
+    bool readSnapshot(uint8_t* dst, size_t len, uint32_t* gen = nullptr) const
+    {
+      uint32_t startGeneration = _frameGeneration.load(std::memory_order_acquire);
+      constexpr uint32_t maxAdvance = Config::tripleBuffer ? 2 : 1;
+
+      if ((gen != nullptr) && (*gen == startGeneration)) {
+        return(false);
+      }
+      len = min(len, (size_t)Channels);
+      while (true) {
+        memcpy(dst, getFrame(), len);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_frameGeneration.load(std::memory_order_relaxed) - startGeneration < maxAdvance) {
+          break;
+        }
+        startGeneration = _frameGeneration.load(std::memory_order_acquire);
+      }
+      if (gen != nullptr) {
+        *gen = startGeneration;
+      }
+      return(true);
+    };
+
+    bool isLocked() const { return (_locked); };
+    unsigned int getChannel() const { return (_channel); };
+    uint32_t rxCount() const { return (_rxCount.load(std::memory_order_relaxed)); };
+
+    // Always 0 unless Config::stats is enabled
+
+    uint32_t rxInvalid() const { if constexpr (Config::stats) { return (_stats.rxInvalid); } else { return (0); } };
+    uint32_t rxOverruns() const { if constexpr (Config::stats) { return (_stats.rxOverruns); } else { return (0); } };
+    uint32_t rxSeqErrors() const { if constexpr (Config::stats) { return (_stats.rxSeqErrors); } else { return (0); } };
+
+    /*
+     * Packet capture, if Config::capture is enabled (otherwise, startCapture() returns false). Like
+     * WirelessDMXReceiver::startCapture(), the buffer is allocated on the first start, preferring PSRAM.
+     * readCapture() takes the oldest recorded packet out of the buffer; clearCapture() releases it.
+     */
+    bool startCapture(size_t depth = WDMX_CAPTURE_DEPTH)
+    {
+      if constexpr (Config::capture) {
+        if (_capture.buffer.capacity() != depth) {
+          clearCapture();
+          if (!_capture.buffer.begin(depth, true)) {
+            return(false);
+          }
+        }
+        _capture.enabled.store(true);
+        return(true);
+      } else {
+        return(false);
+      }
+    };
+
+    void stopCapture() { if constexpr (Config::capture) { _capture.enabled.store(false); } };
+    bool readCapture(wdmxCaptureRecord& record) { if constexpr (Config::capture) { return (_capture.buffer.pop(record)); } else { return (false); } };
+
+    void clearCapture()
+    {
+      if constexpr (Config::capture) {
+        _capture.enabled.store(false);
+        while (_capture.busy.load()) {
+        }
+        _capture.buffer.end();
+      }
+    };
+
+  private:
+    struct wdmxNone {                     // Stands in for disabled features
+      wdmxNone() {};
+      wdmxNone(int) {};
+    };
+    struct wdmxCapture {
+      std::atomic<bool> enabled{false};
+      std::atomic<bool> busy{false};      // Set while the receive task pushes into buffer
+      wdmxSPSCQueue<wdmxCaptureRecord> buffer;
+    };
+    struct wdmxCounters {
+      volatile uint32_t rxInvalid = 0;
+      volatile uint32_t rxOverruns = 0;
+      volatile uint32_t rxSeqErrors = 0;
+    };
+
+    /*
+     * Search for the transmitter, moving outwards from origin. See WirelessDMXReceiver::_relockNext().
+     */
+    void _startRelock(unsigned int origin)
+    {
+      _locked = false;
+      _probing = false;
+      _relockOrigin = origin;
+      _relockStep = 0;
+    };
+
+    /*
+     * Advance the search by one step without blocking: start probing the next channel, or check on the running
+     * probe.
+     */
+    void _relockNext()
+    {
+      if (!_probing) {
+        int distance = (_relockStep + 1) / 2;
+        int channel = _relockOrigin + ((_relockStep % 2) ? distance : -distance);
+
+        _relockStep = (distance > 126) ? 0 : _relockStep + 1;
+        if ((channel < 0) || (channel > 126)) {
+          return;
+        }
+        _startProbe(channel);
+      }
+
+      if (_pollProbe()) {
+        _locked = true;
+        _firstPacket = true;
+        _framePending = false;
+      }
+    };
+
+    void _startProbe(unsigned int channel)
+    {
+      _radio.flush_rx();
+      _radio.openReadingPipe(0, WirelessDMXReceiver::getAddress(channel, Config::ID));
+      _radio.startListening();
+      _radio.setChannel(channel);
+      if constexpr (Config::debug) {
+        Serial.printf("SCAN: Channel %d, unit ID %d\n", channel, Config::ID);
+      }
+      _channel = channel;
+      _probing = true;
+      _probeStarted = micros();
+    };
+
+    /*
+     * Returns true if the running probe found the transmitter. Clears _probing once the probe is over.
+     */
+    bool _pollProbe()
+    {
+      wdmxReceiveBuffer rxBuf;
+
+      if (!_radio.available()) {
+        if (micros() - _probeStarted > WDMX_SCAN_TIMEOUT_US) {
+          _probing = false;
+        }
+        return(false);
+      }
+      _probing = false;
+      _radio.read(&rxBuf, sizeof(rxBuf));
+      return((rxBuf.magic == WDMX_MAGIC_1) || (rxBuf.magic == WDMX_MAGIC_2));
+    };
+
+    void _handlePacket(const wdmxReceiveBuffer& rxBuf)
+    {
+      if constexpr (Config::capture) {
+        if (_capture.enabled.load()) {
+          _capture.busy.store(true);
+          wdmxCaptureRecord* record = _capture.enabled.load() ? _capture.buffer.reserve() : nullptr;
+          if (record != nullptr) {
+            record->timestamp = esp_timer_get_time();
+            record->channel = _channel;
+            record->ID = Config::ID;
+            record->packet = rxBuf;
+            _capture.buffer.commit();
+          }
+          _capture.busy.store(false);
+        }
+      }
+      if constexpr (Config::checkMagic) {
+        if ((rxBuf.magic != WDMX_MAGIC_1) && (rxBuf.magic != WDMX_MAGIC_2)) {
+          if constexpr (Config::stats) {
+            _stats.rxInvalid = _stats.rxInvalid + 1;
+          }
+          return;
+        }
+      }
+      // The transmitter's universe may be smaller than Channels
+      unsigned int universeLastSlot = rxBuf.highestChannelID / WDMX_SLOT_CHANNELS;
+
+      if constexpr (Config::stats) {
+        unsigned int expected = (_prevPayloadID >= universeLastSlot) ? 0 : _prevPayloadID + 1;
+        if (!_firstPacket && (rxBuf.payloadID != expected)) {
+          _stats.rxSeqErrors = _stats.rxSeqErrors + 1;
+        }
+      }
+      _firstPacket = false;
+
+      // If the payload ID went backwards, we missed the end of the previous frame
+      if (_framePending && (rxBuf.payloadID < _prevPayloadID)) {
+        _publishFrame();
+      }
+      _prevPayloadID = rxBuf.payloadID;
+      _rxCount.store(_rxCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+      unsigned int start = rxBuf.payloadID * WDMX_SLOT_CHANNELS;
+      if (start >= Channels) {
+        return; // Beyond what we store; the frame was published with our last slot already
+      }
+      memcpy(&_backBuffer[start], rxBuf.dmxData, min((unsigned int)WDMX_SLOT_CHANNELS, Channels - start));
+      _framePending = true;
+      if (rxBuf.payloadID == min(lastSlot, universeLastSlot)) {
+        _publishFrame();
+      }
+    };
+
+    void _publishFrame()
+    {
+      uint32_t generation = _frameGeneration.load(std::memory_order_relaxed) + 1;
+
+      _framePending = false;
+      if constexpr (Config::tripleBuffer) {
+        _frontBuffer.store(_backBuffer, std::memory_order_release);
+        _frameGeneration.store(generation, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_release);
+        _backIndex = (_backIndex + 1) % 3;
+        memcpy(_frames[_backIndex], _backBuffer, Channels);
+        _backBuffer = _frames[_backIndex];
+      } else {
+        _frameGeneration.store(generation, std::memory_order_release);
+      }
+    };
+
+    /*
+     * Read the payloads waiting in the RX FIFO, with one status read per pass. See WirelessDMXReceiver::_drainFifo().
+     */
+    void _drainFifo()
+    {
+      wdmxReceiveBuffer rxBuf;
+      bool full;
+      bool more;
+
+      if (!_radio.rxFifoStatus(full)) {
+        return;
+      }
+      if constexpr (Config::stats) {
+        if (full) {
+          _stats.rxOverruns = _stats.rxOverruns + 1;
+        }
+      }
+      do {
+        more = _radio.readPayload(&rxBuf, sizeof(rxBuf));
+        _handlePacket(rxBuf);
+      } while (more);
+    };
+
+    void _receiveLoop()
+    {
+      unsigned long lastHousekeeping = millis();
+      unsigned long lastPacketTime = lastHousekeeping;
+      unsigned long lastYield = lastHousekeeping;
+      uint32_t housekeepingRxCount = 0;
+
+      _receiveTask = xTaskGetCurrentTaskHandle();
+      if (_irqPin >= 0) {
+        pinMode(_irqPin, INPUT_PULLUP);
+        attachInterruptArg(digitalPinToInterrupt(_irqPin), _irqHandler, this, FALLING);
+      }
+
+      while (true) {
+        unsigned long now = millis();
+
+        if (now - lastHousekeeping >= WDMX_HOUSEKEEPING_MS) {
+          esp_task_wdt_reset();
+          if (rxCount() != housekeepingRxCount) {
+            housekeepingRxCount = rxCount();
+            lastPacketTime = now;
+          }
+          lastHousekeeping = now;
+        }
+        if (!_locked) {
+          // Probe one channel at a time, so that we keep yielding and feeding the watchdog below
+          _relockNext();
+          if (_locked) {
+            lastPacketTime = millis();
+          }
+        } else if ((Config::signalTimeoutMs != 0) && (now - lastPacketTime > Config::signalTimeoutMs)) {
+          _startRelock(_channel);
+        } else {
+          _drainFifo();
+        }
+
+        if (_locked && (_irqPin >= 0)) {
+          ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WDMX_IRQ_TIMEOUT_MS));
+        } else if (now - lastYield >= WDMX_POLL_YIELD_MS) {
+          vTaskDelay(1);
+          lastYield = millis();
+        }
+      }
+    };
+
+    static void _startReceiveThread(void* _this) { ((WirelessDMXReceiverT*)_this)->_receiveLoop(); };
+
+    static void IRAM_ATTR _irqHandler(void* _this)
+    {
+      BaseType_t higherPriorityTaskWoken = pdFALSE;
+
+      vTaskNotifyGiveFromISR(((WirelessDMXReceiverT*)_this)->_receiveTask, &higherPriorityTaskWoken);
+      if (higherPriorityTaskWoken) {
+        portYIELD_FROM_ISR();
+      }
+    };
+
+    Radio& _radio;
+    int _irqPin;
+    std::conditional_t<Config::statusLED, WirelessDMXStatusLED, wdmxNone> _statusLED;
+    std::conditional_t<Config::stats, wdmxCounters, wdmxNone> _stats;
+    std::conditional_t<Config::capture, wdmxCapture, wdmxNone> _capture;
+    wdmxTaskConfig _taskConfig;
+    TaskHandle_t _receiveTask = nullptr;
+
+    volatile bool _locked = false;
+    volatile unsigned int _channel = 0;
+    std::atomic<uint32_t> _rxCount{0};
+    uint8_t _prevPayloadID = 0;
+    bool _firstPacket = true;         // Don't count a sequence error for the first packet after a lock
+    bool _framePending = false;
+    bool _probing = false;            // A probe started by _startProbe() is running
+    unsigned long _probeStarted = 0;  // micros() when the running probe started
+    unsigned int _relockOrigin = 0;
+    unsigned int _relockStep = 0;
+
+    uint8_t _frames[buffers][Channels];
+    unsigned int _backIndex = 0;
+    uint8_t* _backBuffer;
+    std::atomic<const uint8_t*> _frontBuffer;
+    std::atomic<uint32_t> _frameGeneration{0};
+};
+
+#endif
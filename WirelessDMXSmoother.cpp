@@ -0,0 +1,161 @@
+/*
+  WirelessDMXSmoother.cpp - Interpolate received DMX data at a higher rate than the wireless frame rate
+  Released into the public domain.
+*/
+
+#include "WirelessDMXSmoother.h"
+#include <math.h>
+
+WirelessDMXSmoother::WirelessDMXSmoother(WirelessDMXReceiver& receiver)
+  : _receiver(receiver)
+{
+  memset(_frame, 0x00, sizeof(_frame));
+  memset(_previous, 0x00, sizeof(_previous));
+  memset(_target, 0x00, sizeof(_target));
+  memset(_output, 0x00, sizeof(_output));
+}
+
+void WirelessDMXSmoother::setMode(wdmxSmoothMode_t mode, unsigned int timeConstantMs)
+{
+  _mode = mode;
+  _timeConstantMs = max(timeConstantMs, 1U);
+}
+
+bool WirelessDMXSmoother::set16Bit(unsigned int coarseAddress)
+{
+  if ((coarseAddress < 1) || (coarseAddress >= DMX_BUFSIZE)) {
+    return(false);
+  }
+  // The fine channel is coarseAddress+1, i.e. index coarseAddress
+  _fine[coarseAddress / 32] |= (1UL << (coarseAddress % 32));
+  return(true);
+}
+
+uint8_t WirelessDMXSmoother::getValue(unsigned int address) const
+{
+  unsigned int channel = address - 1;
+
+  if (_fine[channel / 32] & (1UL << (channel % 32))) {
+    return(_output[channel] & 0xFF);
+  }
+  return(_output[channel] >> 8);
+}
+
+bool WirelessDMXSmoother::begin(unsigned int rateHz)
+{
+  esp_timer_create_args_t timerArgs = {};
+  uint64_t periodUs = 1000000 / max(rateHz, 1U);
+
+  if (_timer != nullptr) {
+    return(true);
+  }
+
+  // alpha = 1 - e^(-period / tau), as a Q15 fraction
+  _alpha = (int32_t)(32768.0f * (1.0f - expf(-(float)periodUs / (_timeConstantMs * 1000.0f))));
+  _alpha = constrain(_alpha, 1, 32768);
+
+  timerArgs.callback = _tick;
+  timerArgs.arg = this;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "WDMX smoother";
+  if (esp_timer_create(&timerArgs, &_timer) != ESP_OK) {
+    _timer = nullptr;
+    return(false);
+  }
+  esp_timer_start_periodic(_timer, periodUs);
+  return(true);
+}
+
+void WirelessDMXSmoother::end()
+{
+  if (_timer == nullptr) {
+    return;
+  }
+  esp_timer_stop(_timer);
+  esp_timer_delete(_timer);
+  _timer = nullptr;
+}
+
+void WirelessDMXSmoother::_tick(void* _this)
+{
+  WirelessDMXSmoother* smoother = (WirelessDMXSmoother*)_this;
+  int64_t now = esp_timer_get_time();
+
+  smoother->_loadFrame(now);
+  smoother->_update(now);
+  smoother->_tickDuration = esp_timer_get_time() - now;
+  if (smoother->_tickCallback) {
+    smoother->_tickCallback(smoother->_output, smoother->_count);
+  }
+}
+
+/*
+ * If the receiver published a new frame, make it the new target.
+ */
+void WirelessDMXSmoother::_loadFrame(int64_t now)
+{
+  uint32_t generation = _generation;
+
+  if (!_receiver.readSnapshot(_frame, sizeof(_frame), &generation)) {
+    return;
+  }
+  _generation = generation;
+
+  // Track the frame period, ignoring gaps from signal loss
+  if (_frameTime != 0) {
+    int64_t gap = now - _frameTime;
+    if (gap < WDMX_SMOOTH_MAX_GAP_US) {
+      _frameInterval += (gap - _frameInterval) / 8;
+    }
+  }
+  _frameTime = now;
+
+  unsigned int count = _receiver.getChannelCount();
+  if (count < _count) {
+    // Channels that left the universe are zero on the receiver; follow suit right away
+    memset(&_output[count], 0x00, (_count - count) * sizeof(_output[0]));
+  }
+  _count = count;
+
+  memcpy(_previous, _output, _count * sizeof(_output[0]));
+  for (unsigned int i = 0; i < _count; i++) {
+    _target[i] = _frame[i] * 257;
+  }
+  for (unsigned int word = 0; word < WDMX_DIRTY_WORDS; word++) {
+    uint32_t fine = _fine[word];
+    while (fine != 0) {
+      unsigned int channel = word * 32 + __builtin_ctz(fine);
+      fine &= fine - 1;
+      if (channel < _count) {
+        _target[channel-1] = (_frame[channel-1] << 8) | _frame[channel];
+        _target[channel] = _target[channel-1];
+      }
+    }
+  }
+}
+
+/*
+ * Compute the output values for this tick. Both loops run over plain uint16_t arrays with a single multiply per
+ * channel and no branches, so that the compiler can unroll them. tickDuration() shows what a tick actually costs.
+ */
+void WirelessDMXSmoother::_update(int64_t now)
+{
+  if (_mode == WDMX_SMOOTH_LINEAR) {
+    int64_t elapsed = now - _frameTime;
+    int32_t fraction = (elapsed >= _frameInterval) ? 32768 : (int32_t)((elapsed << 15) / _frameInterval);
+
+    if (fraction == 32768) {
+      memcpy(_output, _target, _count * sizeof(_output[0]));
+      return;
+    }
+    for (unsigned int i = 0; i < _count; i++) {
+      int32_t delta = (int32_t)_target[i] - _previous[i];
+      _output[i] = _previous[i] + ((delta * fraction) >> 15);
+    }
+  } else {
+    for (unsigned int i = 0; i < _count; i++) {
+      int32_t delta = (int32_t)_target[i] - _output[i];
+      _output[i] += (delta * _alpha + 16384) >> 15;
+    }
+  }
+}
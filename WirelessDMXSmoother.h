@@ -0,0 +1,96 @@
+/*
+  WirelessDMXSmoother.h - Interpolate received DMX data at a higher rate than the wireless frame rate
+  Released into the public domain.
+*/
+
+#ifndef WirelessDMXSmoother_h
+#define WirelessDMXSmoother_h
+
+#include "Arduino.h"
+#include <esp_timer.h>
+#include "WirelessDMXReceiver.h"
+
+#define WDMX_SMOOTH_RATE_HZ           500   // Default output rate
+#define WDMX_SMOOTH_TIME_CONSTANT_MS   20   // Default time constant in WDMX_SMOOTH_LOWPASS mode
+#define WDMX_SMOOTH_FRAME_US        33000   // Initial estimate of the time between two frames (30 frames/s)
+#define WDMX_SMOOTH_MAX_GAP_US     200000   // Gaps between frames longer than this don't update the estimate
+
+enum wdmxSmoothMode_t {                     // How WirelessDMXSmoother gets from one frame to the next
+  WDMX_SMOOTH_LINEAR = 0,                   // Fade linearly from the previous to the current frame over one frame period
+  WDMX_SMOOTH_LOWPASS = 1                   // First order low-pass filter towards the current frame
+};
+
+/*
+ * Produces smoothed 16 bit channel values at a rate well above the ~30 frames/s the transmitter delivers, to avoid
+ * visible steps on slow fades with high resolution PWM.
+ *
+ * A periodic esp_timer picks up new frames from the receiver (through readSnapshot(), so it may run on either
+ * core) and computes the output values. In WDMX_SMOOTH_LINEAR mode, each channel fades from where it was when a
+ * frame arrived to that frame's value, over the measured frame period; this adds one frame period of latency. In
+ * WDMX_SMOOTH_LOWPASS mode, each channel approaches the latest value with the configured time constant.
+ *
+ * Channels are 16 bit internally: an 8 bit value v becomes v * 257, so that 255 maps to 65535. Channel pairs
+ * registered with set16Bit() are combined into one 16 bit value (coarse channel first) before smoothing.
+ */
+class WirelessDMXSmoother
+{
+  public:
+    WirelessDMXSmoother(WirelessDMXReceiver& receiver);
+    ~WirelessDMXSmoother() { end(); };
+
+    /*
+     * Select the smoothing mode. timeConstantMs only applies to WDMX_SMOOTH_LOWPASS. Must be called before begin().
+     */
+    void setMode(wdmxSmoothMode_t mode, unsigned int timeConstantMs = WDMX_SMOOTH_TIME_CONSTANT_MS);
+
+    /*
+     * Treat coarseAddress and coarseAddress+1 as the high and low byte of one 16 bit channel. Must be called
+     * before begin(). Returns false if the pair does not fit into the universe.
+     */
+    bool set16Bit(unsigned int coarseAddress);
+
+    /*
+     * Register a callback that is invoked after every tick with the new values (indexed from 0, like dmxBuffer).
+     * It runs on the esp_timer task, so it must return quickly - e.g. write PWM duty cycles and nothing else.
+     */
+    void onTick(std::function<void(const uint16_t* values, unsigned int count)> callback) { _tickCallback = callback; };
+
+    bool begin(unsigned int rateHz = WDMX_SMOOTH_RATE_HZ);
+    void end();
+
+    /*
+     * Smoothed value of a channel. getValue16() returns the 16 bit value; for both channels of a 16 bit pair, that
+     * is the combined value. getValue() returns the 8 bit value of the channel: the high byte for normal and coarse
+     * channels, the low byte for fine channels.
+     */
+    uint16_t getValue16(unsigned int address) const { return (_output[address-1]); };
+    uint8_t getValue(unsigned int address) const;
+
+    int64_t tickDuration() const { return (_tickDuration); };   // Time the last tick took, in us
+
+  private:
+    static void _tick(void*);
+    void _loadFrame(int64_t now);
+    void _update(int64_t now);
+
+    WirelessDMXReceiver& _receiver;
+    wdmxSmoothMode_t _mode = WDMX_SMOOTH_LINEAR;
+    unsigned int _timeConstantMs = WDMX_SMOOTH_TIME_CONSTANT_MS;
+    int32_t _alpha;                     // Low-pass filter coefficient per tick, Q15
+    uint32_t _fine[WDMX_DIRTY_WORDS] = {};  // Bitmap of fine channels of 16 bit pairs
+    esp_timer_handle_t _timer = nullptr;
+    std::function<void(const uint16_t*, unsigned int)> _tickCallback;
+
+    uint32_t _generation = 0;           // frameGeneration() of the frame in _frame
+    int64_t _frameTime = 0;             // esp_timer_get_time() when we picked up the last frame
+    int64_t _frameInterval = WDMX_SMOOTH_FRAME_US;
+    unsigned int _count = DMX_BUFSIZE;  // Channels in the universe
+    volatile int64_t _tickDuration = 0;
+
+    uint8_t _frame[DMX_BUFSIZE];
+    uint16_t _previous[DMX_BUFSIZE];    // Output values when the current frame arrived
+    uint16_t _target[DMX_BUFSIZE];      // Values of the current frame
+    uint16_t _output[DMX_BUFSIZE];
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*
+  WirelessDMXStatusLED.cpp - Status LED indicator for the WirelessDMXReceiver library
+  Released into the public domain.
+*/
+
+#include "WirelessDMXStatusLED.h"
+
+WirelessDMXStatusLED::WirelessDMXStatusLED(int pin)
+{
+  _pin = pin;
+}
+
+/*
+ * Start driving the LED. Does nothing if the pin is 0 (no status LED).
+ */
+void WirelessDMXStatusLED::_begin(const void* receiver, bool (*isLocked)(const void*), unsigned int (*rxCount)(const void*))
+{
+  esp_timer_create_args_t timerArgs = {};
+
+  if ((_pin == 0) || (_timer != nullptr)) {
+    return;
+  }
+  _receiver = receiver;
+  _isLocked = isLocked;
+  _rxCount = rxCount;
+
+  timerArgs.callback = _update;
+  timerArgs.arg = this;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "WDMX status LED";
+  if (esp_timer_create(&timerArgs, &_timer) != ESP_OK) {
+    _timer = nullptr;
+    return;
+  }
+  esp_timer_start_periodic(_timer, WDMX_LED_UPDATE_MS * 1000);
+}
+
+void WirelessDMXStatusLED::end()
+{
+  if (_timer == nullptr) {
+    return;
+  }
+  esp_timer_stop(_timer);
+  esp_timer_delete(_timer);
+  _timer = nullptr;
+  analogWrite(_pin, 0);
+}
+
+void WirelessDMXStatusLED::_update(void* _this)
+{
+  WirelessDMXStatusLED* led = (WirelessDMXStatusLED*)_this;
+  unsigned int rxCount = led->_rxCount(led->_receiver);
+
+  led->_ticks++;
+  if (!led->_isLocked(led->_receiver)) {
+    // Blink status LED while scanning - this will flash quickly
+    analogWrite(led->_pin, ((led->_ticks * WDMX_LED_UPDATE_MS / WDMX_LED_SCAN_BLINK_MS) % 2) ? 255 : 0);
+  } else if ((rxCount / 1024) % 2) {
+    // Pulse status LED when we're receiving
+    analogWrite(led->_pin, (rxCount % 1024)/4);
+  } else {
+    analogWrite(led->_pin, 255-((rxCount % 1024)/4));
+  }
+}
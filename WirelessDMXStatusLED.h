@@ -0,0 +1,50 @@
+/*
+  WirelessDMXStatusLED.h - Status LED indicator for the WirelessDMXReceiver library
+  Released into the public domain.
+*/
+
+#ifndef WirelessDMXStatusLED_h
+#define WirelessDMXStatusLED_h
+
+#include "Arduino.h"
+#include <esp_timer.h>
+
+#define WDMX_LED_UPDATE_MS             20   // LED update interval
+#define WDMX_LED_SCAN_BLINK_MS        160   // Time the LED stays on/off while scanning
+
+/*
+ * Drives a status LED from a low-rate esp_timer, based on the receiver's lock state and packet counter:
+ * the LED blinks quickly while scanning, and slowly pulses (at a rate proportional to the packet rate) while
+ * receiving. The receive task itself never touches the LED.
+ */
+class WirelessDMXStatusLED
+{
+  public:
+    WirelessDMXStatusLED(int pin);
+    ~WirelessDMXStatusLED() { end(); };
+
+    /*
+     * Start driving the LED from the given receiver: anything with isLocked() and rxCount(), i.e.
+     * WirelessDMXReceiver or WirelessDMXReceiverT.
+     */
+    template <typename Receiver>
+    void begin(const Receiver& receiver) {
+      _begin(&receiver,
+             [](const void* r) { return (((const Receiver*)r)->isLocked()); },
+             [](const void* r) { return ((unsigned int)((const Receiver*)r)->rxCount()); });
+    };
+    void end();
+
+  private:
+    void _begin(const void* receiver, bool (*isLocked)(const void*), unsigned int (*rxCount)(const void*));
+    static void _update(void*);
+
+    int _pin;
+    const void* _receiver = nullptr;
+    bool (*_isLocked)(const void*);
+    unsigned int (*_rxCount)(const void*);
+    esp_timer_handle_t _timer = nullptr;
+    unsigned int _ticks = 0;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+  DecoderBenchmark - measure the per-packet cost of the WirelessDMXReceiver decoder
+
+  Feeds synthetic Wireless DMX packets into WirelessDMXReceiver::processPacket() and reports packets/s and CPU
+  cycles per packet for each buffer mode. No radio is needed; begin() is never called.
+
+  The transmitter sends 540 packets/s, so anything above that is headroom.
+
+  The host build in test/host builds this sketch as the DecoderBenchmark program. There, cycles are counted at a
+  nominal 240MHz, so only compare them with other host runs.
+*/
+
+#include <WirelessDMXReceiver.h>
+#include <esp_timer.h>
+
+#define RF24_PIN_CE     4   // Not used - the radio is never started
+#define RF24_PIN_CSN    5
+#define PACKETS    100000   // Packets per run
+
+WirelessDMXReceiver receiver(RF24_PIN_CE, RF24_PIN_CSN, 0);
+
+/*
+ * Generate the packets of one universe, like a transmitter sending a slow fade on all channels.
+ */
+void fillUniverse(WirelessDMXReceiver::wdmxReceiveBuffer* packets, unsigned int numPackets, unsigned int step)
+{
+  for (unsigned int i = 0; i < numPackets; i++) {
+    packets[i].magic = WDMX_MAGIC_1;
+    packets[i].payloadID = i;
+    packets[i].highestChannelID = DMX_BUFSIZE - 1;
+    for (unsigned int j = 0; j < sizeof(packets[i].dmxData); j++) {
+      packets[i].dmxData[j] = (i * sizeof(packets[i].dmxData) + j + step) & 0xFF;
+    }
+  }
+}
+
+void runBenchmark(const char* name, bool changingData)
+{
+  const unsigned int numPackets = (DMX_BUFSIZE - 1) / sizeof(WirelessDMXReceiver::wdmxReceiveBuffer::dmxData) + 1;
+  static WirelessDMXReceiver::wdmxReceiveBuffer universes[2][numPackets];
+
+  fillUniverse(universes[0], numPackets, 0);
+  fillUniverse(universes[1], numPackets, changingData ? 1 : 0);
+
+  int64_t start = esp_timer_get_time();
+  for (unsigned int i = 0; i < PACKETS; i++) {
+    receiver.processPacket(universes[(i / numPackets) % 2][i % numPackets]);
+  }
+  int64_t elapsed = esp_timer_get_time() - start;
+
+  Serial.printf("%-32s %8llu packets/s, %5llu cycles/packet, %lu frames\n", name,
+                (unsigned long long)PACKETS * 1000000 / elapsed, (unsigned long long)elapsed * ESP.getCpuFreqMHz() / PACKETS,
+                (unsigned long)receiver.frameGeneration());
+}
+
+void setup()
+{
+  uint32_t dirty[WDMX_DIRTY_WORDS];
+
+  Serial.begin(115200);
+  Serial.printf("Decoding %d packets per run, CPU at %luMHz\n", PACKETS, (unsigned long)ESP.getCpuFreqMHz());
+
+  receiver.setBufferMode(WDMX_BUFFER_DIRECT);
+  runBenchmark("Direct, static data", false);
+  runBenchmark("Direct, changing data", true);
+  receiver.fetchAndClearDirty(dirty);
+
+  receiver.setBufferMode(WDMX_BUFFER_TRIPLE);
+  runBenchmark("Triple buffer, static data", false);
+  runBenchmark("Triple buffer, changing data", true);
+
+  receiver.enableFrameQueue(4); // Never drained, so this measures the cost of a full queue
+  runBenchmark("Triple buffer, frame queue", true);
+}
+
+void loop()
+{
+}
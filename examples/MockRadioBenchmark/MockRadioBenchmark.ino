@@ -0,0 +1,148 @@
+/*
+  MockRadioBenchmark - benchmark WirelessDMXReceiver against a simulated transmitter
+
+  Uses WirelessDMXMockRadio instead of an nRF24L01, so no RF hardware is needed. Measures
+  - end-to-end receive throughput with the transmitter running SPEEDUP times faster than real time,
+  - time to re-acquire the signal after the transmitter was power-cycled,
+  - scan time for transmitters at different channel/unit ID placements, for both scan modes,
+  - the share of time spent sleeping in idle mode, and the time to re-acquire from idle mode.
+
+  Current draw in idle mode needs to be measured on real hardware; the share of time spent sleeping is what
+  determines it.
+
+  The per-packet cost of the decoder itself, with and without triple buffering and dirty tracking, is measured
+  by the DecoderBenchmark example.
+
+  The sketch runs on an ESP32 without a radio connected, or on the host: the host build in test/host builds it as
+  the MockRadioBenchmark program.
+*/
+
+#include <WirelessDMXReceiver.h>
+#include <WirelessDMXMockRadio.h>
+
+#define SPEEDUP           20   // Packet rate of the throughput test, relative to a real transmitter
+#define BUFFER_MODE       WDMX_BUFFER_TRIPLE
+
+struct placement {
+  unsigned int channel;
+  wdmxID_t ID;
+  wdmxID_t configID;
+};
+
+static const placement placements[] = {
+  { 0,   RED,    RED  },
+  { 126, RED,    RED  },
+  { 64,  GREEN,  AUTO },
+  { 64,  WHITE,  AUTO },
+  { 126, WHITE,  AUTO },
+};
+
+void measureThroughput()
+{
+  WirelessDMXMockRadio* radio = new WirelessDMXMockRadio(42, BLUE);
+  WirelessDMXReceiver* receiver = new WirelessDMXReceiver(*radio);
+  uint8_t universe[DMX_BUFSIZE];
+
+  for (unsigned int i = 0; i < sizeof(universe); i++) {
+    universe[i] = i;
+  }
+  radio->setUniverse(universe, sizeof(universe));
+  receiver->setLockPersistence(false);
+  receiver->setBufferMode(BUFFER_MODE);
+  receiver->begin(BLUE);
+
+  radio->setSpeedup(SPEEDUP);
+  delay(100);
+  unsigned int rxStart = receiver->rxCount();
+  uint32_t generationStart = receiver->frameGeneration();
+  uint32_t droppedStart = radio->packetsDropped();
+  unsigned long start = millis();
+  delay(2000);
+  unsigned long elapsed = millis() - start;
+  Serial.printf("Throughput: %lu packets/s, %lu frames/s, %lu dropped/s (transmitter sends %u packets/s)\n",
+                (receiver->rxCount() - rxStart) * 1000UL / elapsed, (receiver->frameGeneration() - generationStart) * 1000UL / elapsed,
+                (radio->packetsDropped() - droppedStart) * 1000UL / elapsed, 540 * SPEEDUP);
+
+  // Power-cycle the transmitter and measure how long it takes to notice, and to get back
+  radio->setSpeedup(1);
+  radio->setTransmitterEnabled(false);
+  start = millis();
+  while (receiver->isLocked()) {
+    delay(1);
+  }
+  Serial.printf("Signal loss detected after %lums\n", millis() - start);
+  radio->setTransmitter(44, BLUE); // Come back on a nearby channel
+  radio->setTransmitterEnabled(true);
+  start = millis();
+  while (!receiver->isLocked()) {
+    delay(1);
+  }
+  Serial.printf("Re-acquired signal 2 channels away after %lums\n", millis() - start);
+
+  delete receiver; // Stops its receive task, which would otherwise skew the next measurements
+  delete radio;
+}
+
+void measureScan(const placement& p, wdmxScanMode_t mode)
+{
+  WirelessDMXMockRadio* radio = new WirelessDMXMockRadio(p.channel, p.ID);
+  WirelessDMXReceiver* receiver = new WirelessDMXReceiver(*radio);
+
+  receiver->setLockPersistence(false);
+  receiver->setScanMode(mode);
+  unsigned long start = millis();
+  receiver->begin(p.configID);
+  Serial.printf("Scan (%s, configured ID %d): transmitter on channel %3d, unit ID %d found after %5lums\n",
+                (mode == WDMX_SCAN_FAST) ? "fast" : "exhaustive", p.configID, p.channel, p.ID, millis() - start);
+
+  delete receiver;
+  delete radio;
+}
+
+void measureIdle(unsigned int channel)
+{
+  WirelessDMXMockRadio* radio = new WirelessDMXMockRadio(20, BLUE);
+  WirelessDMXReceiver* receiver = new WirelessDMXReceiver(*radio);
+
+  receiver->setLockPersistence(false);
+  receiver->setIdleMode(2000);
+  receiver->begin(BLUE);
+
+  radio->setTransmitterEnabled(false);
+  while (!receiver->isIdle()) {
+    delay(1);
+  }
+  unsigned long idleStart = receiver->idleMillis();
+  unsigned long start = millis();
+  delay(5000);
+  Serial.printf("Idle mode: sleeping %lu%% of the time\n", (receiver->idleMillis() - idleStart) * 100 / (millis() - start));
+
+  radio->setTransmitter(channel, BLUE);
+  radio->setTransmitterEnabled(true);
+  start = millis();
+  while (!receiver->isLocked()) {
+    delay(1);
+  }
+  Serial.printf("Idle mode: re-acquired transmitter on channel %d (lost on 20) after %lums, %lums after losing it\n",
+                channel, millis() - start, receiver->lastReacquireMillis());
+
+  delete receiver;
+  delete radio;
+}
+
+void setup()
+{
+  Serial.begin(115200);
+
+  measureThroughput();
+  for (const placement& p : placements) {
+    measureScan(p, WDMX_SCAN_EXHAUSTIVE);
+    measureScan(p, WDMX_SCAN_FAST);
+  }
+  measureIdle(20);
+  measureIdle(30);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,95 @@
+/*
+  Arduino.h - Host shim for the subset of the Arduino-ESP32 core the WirelessDMXReceiver library uses
+  Released into the public domain.
+
+  Time is the host's monotonic clock, Serial writes to stdout, and pins do nothing.
+*/
+
+#ifndef HOST_ARDUINO_h
+#define HOST_ARDUINO_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+using std::min;
+using std::max;
+
+#define IRAM_ATTR
+#define HIGH                          0x1
+#define LOW                           0x0
+#define INPUT                        0x01
+#define OUTPUT                       0x03
+#define INPUT_PULLUP                 0x05
+#define RISING                       0x01
+#define FALLING                      0x02
+#define CHANGE                       0x03
+
+#define _BV(b)              (1UL << (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define digitalPinToInterrupt(pin)  (pin)
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline void digitalWrite(uint8_t pin, uint8_t value) {}
+inline int digitalRead(uint8_t pin) { return (HIGH); }
+inline void analogWrite(uint8_t pin, int value) {}
+inline void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {}
+inline void detachInterrupt(uint8_t pin) {}
+
+class Print
+{
+  public:
+    virtual ~Print() {};
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    virtual void flush() {};
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char* s) { return (write((const uint8_t*)s, strlen(s))); };
+    size_t println(const char* s = "") { return (print(s) + print("\r\n")); };
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available() { return (0); };
+    virtual int read() { return (-1); };
+};
+
+class HardwareSerial : public Stream
+{
+  public:
+    void begin(unsigned long baud) {};
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    void flush() override;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass
+{
+  public:
+    uint32_t getCpuFreqMHz() { return (240); };
+    uint32_t getCycleCount() { return ((uint32_t)(micros() * getCpuFreqMHz())); };
+    uint64_t getEfuseMac() { return (0x0000DEADBEEF0000ULL); };
+};
+
+extern EspClass ESP;
+
+#endif
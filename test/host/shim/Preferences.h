@@ -0,0 +1,31 @@
+/*
+  Preferences.h - Host shim for the Arduino-ESP32 Preferences library. Keys live in memory for the lifetime of the
+  program, shared by all instances like NVS is.
+  Released into the public domain.
+*/
+
+#ifndef HOST_PREFERENCES_h
+#define HOST_PREFERENCES_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+class Preferences
+{
+  public:
+    bool begin(const char* name, bool readOnly = false) { _namespace = name; _open = true; return (true); };
+    void end() { _open = false; };
+
+    bool isKey(const char* key);
+    bool remove(const char* key);
+    bool clear();
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+    size_t putUChar(const char* key, uint8_t value);
+
+  private:
+    std::string _namespace;
+    bool _open = false;
+};
+
+#endif
@@ -0,0 +1,52 @@
+/*
+  RF24.h - Host shim for the RF24 library. There is no radio on the host, so begin() fails; use
+  WirelessDMXMockRadio instead.
+  Released into the public domain.
+*/
+
+#ifndef HOST_RF24_h
+#define HOST_RF24_h
+
+#include <stdint.h>
+#include "SPI.h"
+
+typedef enum { RF24_1MBPS = 0, RF24_2MBPS, RF24_250KBPS } rf24_datarate_e;
+typedef enum { RF24_CRC_DISABLED = 0, RF24_CRC_8, RF24_CRC_16 } rf24_crclength_e;
+typedef enum { RF24_PA_MIN = 0, RF24_PA_LOW, RF24_PA_HIGH, RF24_PA_MAX, RF24_PA_ERROR } rf24_pa_dbm_e;
+
+class RF24
+{
+  public:
+    RF24(uint16_t cePin, uint16_t csnPin, uint32_t spiSpeed = 10000000) {};
+
+    bool begin() { return (false); };
+    bool begin(SPIClass* spiBus) { return (false); };
+    bool isChipConnected() { return (false); };
+    void printPrettyDetails() {};
+
+    void setDataRate(rf24_datarate_e speed) {};
+    void setCRCLength(rf24_crclength_e length) {};
+    void setPALevel(uint8_t level, bool lnaEnable = true) {};
+    void setAutoAck(bool enable) {};
+    void setPayloadSize(uint8_t size) {};
+
+    uint8_t flush_rx() { return (0); };
+    void openReadingPipe(uint8_t pipe, uint64_t address) {};
+    void closeReadingPipe(uint8_t pipe) {};
+    void startListening() {};
+    void stopListening() {};
+    void setChannel(uint8_t channel) { _channel = channel; };
+    uint8_t getChannel() { return (_channel); };
+
+    bool available() { return (false); };
+    bool available(uint8_t* pipe) { return (false); };
+    void read(void* buf, uint8_t len) {};
+    bool rxFifoFull() { return (false); };
+    bool testRPD() { return (false); };
+    void maskIRQ(bool tx_ok, bool tx_fail, bool rx_ready) {};
+
+  private:
+    uint8_t _channel = 76;
+};
+
+#endif
@@ -0,0 +1,41 @@
+/*
+  SPI.h - Host shim for the Arduino SPI library. No device is connected: every byte reads back as 0xFF.
+  Released into the public domain.
+*/
+
+#ifndef HOST_SPI_h
+#define HOST_SPI_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define MSBFIRST                        1
+#define SPI_MODE0                       0
+#define FSPI                            0
+#define HSPI                            1
+#define VSPI                            2
+
+class SPISettings
+{
+  public:
+    SPISettings() {};
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {};
+};
+
+class SPIClass
+{
+  public:
+    SPIClass(uint8_t bus = VSPI) {};
+
+    void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {};
+    void end() {};
+    void beginTransaction(SPISettings settings) {};
+    void endTransaction() {};
+    uint8_t transfer(uint8_t data) { return (0xFF); };
+    void transferBytes(const uint8_t* data, uint8_t* out, uint32_t size) { memset(out, 0xFF, size); };
+    void writeBytes(const uint8_t* data, uint32_t size) {};
+};
+
+extern SPIClass SPI;
+
+#endif
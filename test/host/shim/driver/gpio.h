@@ -0,0 +1,22 @@
+/*
+  driver/gpio.h - Host shim for the ESP-IDF GPIO driver. There are no pins on the host.
+  Released into the public domain.
+*/
+
+#ifndef HOST_DRIVER_GPIO_h
+#define HOST_DRIVER_GPIO_h
+
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+
+typedef enum {
+  GPIO_INTR_DISABLE = 0,
+  GPIO_INTR_LOW_LEVEL = 4,
+  GPIO_INTR_HIGH_LEVEL = 5
+} gpio_int_type_t;
+
+inline esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t type) { return (ESP_OK); }
+inline esp_err_t gpio_wakeup_disable(gpio_num_t pin) { return (ESP_OK); }
+
+#endif
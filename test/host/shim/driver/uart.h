@@ -0,0 +1,47 @@
+/*
+  driver/uart.h - Host shim for the ESP-IDF UART driver
+  Released into the public domain.
+
+  Nothing is sent anywhere, but writes take as long as they would at 250kbaud with 8N2 framing, so the output
+  task runs at its real frame rate.
+*/
+
+#ifndef HOST_DRIVER_UART_h
+#define HOST_DRIVER_UART_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int uart_port_t;
+
+typedef enum { UART_DATA_8_BITS = 3 } uart_word_length_t;
+typedef enum { UART_PARITY_DISABLE = 0 } uart_parity_t;
+typedef enum { UART_STOP_BITS_1 = 1, UART_STOP_BITS_2 = 3 } uart_stop_bits_t;
+typedef enum { UART_HW_FLOWCTRL_DISABLE = 0 } uart_hw_flowcontrol_t;
+typedef enum { UART_SCLK_DEFAULT = 0 } uart_sclk_t;
+
+typedef struct {
+  int baud_rate;
+  uart_word_length_t data_bits;
+  uart_parity_t parity;
+  uart_stop_bits_t stop_bits;
+  uart_hw_flowcontrol_t flow_ctrl;
+  uint8_t rx_flow_ctrl_thresh;
+  uart_sclk_t source_clk;
+} uart_config_t;
+
+#define UART_PIN_NO_CHANGE             -1
+
+esp_err_t uart_driver_install(uart_port_t port, int rxBufferSize, int txBufferSize, int queueSize, void* queue,
+                              int interruptFlags);
+esp_err_t uart_driver_delete(uart_port_t port);
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t* config);
+esp_err_t uart_set_pin(uart_port_t port, int txPin, int rxPin, int rtsPin, int ctsPin);
+esp_err_t uart_set_tx_idle_num(uart_port_t port, uint16_t idleBits);
+int uart_write_bytes(uart_port_t port, const void* data, size_t size);
+int uart_write_bytes_with_break(uart_port_t port, const void* data, size_t size, int breakBits);
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticksToWait);
+
+#endif
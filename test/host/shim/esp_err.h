@@ -0,0 +1,17 @@
+/*
+  esp_err.h - Host shim for ESP-IDF error codes
+  Released into the public domain.
+*/
+
+#ifndef HOST_ESP_ERR_h
+#define HOST_ESP_ERR_h
+
+typedef int esp_err_t;
+
+#define ESP_OK                          0
+#define ESP_FAIL                       -1
+#define ESP_ERR_NO_MEM              0x101
+#define ESP_ERR_INVALID_ARG         0x102
+#define ESP_ERR_INVALID_STATE       0x103
+
+#endif
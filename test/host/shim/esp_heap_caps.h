@@ -0,0 +1,20 @@
+/*
+  esp_heap_caps.h - Host shim for the ESP-IDF capability based allocator. Every capability maps to malloc().
+  Released into the public domain.
+*/
+
+#ifndef HOST_ESP_HEAP_CAPS_h
+#define HOST_ESP_HEAP_CAPS_h
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT            (1 << 2)
+#define MALLOC_CAP_SPIRAM         (1 << 10)
+#define MALLOC_CAP_INTERNAL       (1 << 11)
+#define MALLOC_CAP_DEFAULT        (1 << 12)
+
+inline void* heap_caps_malloc(size_t size, uint32_t caps) { return (malloc(size)); }
+inline void heap_caps_free(void* ptr) { free(ptr); }
+
+#endif
@@ -0,0 +1,25 @@
+/*
+  esp_sleep.h - Host shim for ESP-IDF light sleep
+  Released into the public domain.
+
+  Light sleep blocks the calling thread until the timer wakeup, if one is enabled. GPIO wakeups never fire.
+*/
+
+#ifndef HOST_ESP_SLEEP_h
+#define HOST_ESP_SLEEP_h
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+  ESP_SLEEP_WAKEUP_ALL = 0,
+  ESP_SLEEP_WAKEUP_TIMER = 4,
+  ESP_SLEEP_WAKEUP_GPIO = 7
+} esp_sleep_source_t;
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeUs);
+esp_err_t esp_sleep_enable_gpio_wakeup();
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t source);
+esp_err_t esp_light_sleep_start();
+
+#endif
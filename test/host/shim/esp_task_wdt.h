@@ -0,0 +1,16 @@
+/*
+  esp_task_wdt.h - Host shim for the ESP-IDF task watchdog, which does nothing on the host
+  Released into the public domain.
+*/
+
+#ifndef HOST_ESP_TASK_WDT_h
+#define HOST_ESP_TASK_WDT_h
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+inline esp_err_t esp_task_wdt_add(TaskHandle_t task) { return (ESP_OK); }
+inline esp_err_t esp_task_wdt_delete(TaskHandle_t task) { return (ESP_OK); }
+inline esp_err_t esp_task_wdt_reset() { return (ESP_OK); }
+
+#endif
@@ -0,0 +1,68 @@
+/*
+  freertos/FreeRTOS.h - Host shim for the subset of FreeRTOS the WirelessDMXReceiver library uses
+  Released into the public domain.
+
+  Tasks are std::threads. Priorities and core affinity are accepted and ignored, and one tick is one millisecond.
+*/
+
+#ifndef HOST_FREERTOS_h
+#define HOST_FREERTOS_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t EventBits_t;
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef struct EventGroupDef_t* EventGroupHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+typedef struct {                            // Storage for xEventGroupCreateStatic(); unused on the host
+  void* dummy;
+} StaticEventGroup_t;
+
+typedef struct {
+  int owner;
+} portMUX_TYPE;
+
+#define pdTRUE                          1
+#define pdFALSE                         0
+#define pdPASS                          1
+#define pdFAIL                          0
+#define portMAX_DELAY          0xFFFFFFFF
+#define portTICK_PERIOD_MS              1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define tskNO_AFFINITY         0x7FFFFFFF
+#define configMAX_PRIORITIES           25
+#define portMUX_INITIALIZER_UNLOCKED  { 0 }
+#define portYIELD_FROM_ISR(...)  ((void)0)
+#define portENTER_CRITICAL(mux)  hostEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)   hostExitCritical(mux)
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackSize, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);       // Only a task deleting itself (nullptr) is supported
+void vTaskDelay(TickType_t ticks);
+void taskYIELD();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+
+EventGroupHandle_t xEventGroupCreate();
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t* buffer);
+void vEventGroupDelete(EventGroupHandle_t group);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit, BaseType_t waitForAll,
+                                TickType_t ticksToWait);
+
+void hostEnterCritical(portMUX_TYPE* mux);
+void hostExitCritical(portMUX_TYPE* mux);
+
+#endif
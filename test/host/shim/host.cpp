@@ -0,0 +1,514 @@
+/*
+  host.cpp - Host implementation of the Arduino, FreeRTOS and ESP-IDF shims
+  Released into the public domain.
+*/
+
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "Arduino.h"
+#include "Preferences.h"
+#include "SPI.h"
+#include "driver/uart.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+
+#define HOST_UART_BIT_US                4   // 250kbaud
+#define HOST_UART_FRAME_BITS           11   // 8N2: start bit, 8 data bits, 2 stop bits
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+HardwareSerial Serial;
+EspClass ESP;
+SPIClass SPI;
+
+/*
+ * Time
+ */
+static uint64_t hostMicros()
+{
+  return (std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+unsigned long millis()
+{
+  return (hostMicros() / 1000);
+}
+
+unsigned long micros()
+{
+  return (hostMicros());
+}
+
+void delay(uint32_t ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+int64_t esp_timer_get_time()
+{
+  return (hostMicros());
+}
+
+/*
+ * Print and Serial
+ */
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  size_t n = 0;
+
+  while (n < size && write(buffer[n])) {
+    n++;
+  }
+  return (n);
+}
+
+size_t Print::printf(const char* format, ...)
+{
+  char buf[256];
+  char* out = buf;
+  va_list args;
+
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (len < 0) {
+    return (0);
+  }
+  if ((size_t)len >= sizeof(buf)) {
+    out = (char*)malloc(len + 1);
+    if (out == nullptr) {
+      return (0);
+    }
+    va_start(args, format);
+    vsnprintf(out, len + 1, format, args);
+    va_end(args);
+  }
+  size_t written = write((const uint8_t*)out, len);
+  if (out != buf) {
+    free(out);
+  }
+  return (written);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return (fwrite(&c, 1, 1, stdout));
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+  return (fwrite(buffer, 1, size, stdout));
+}
+
+void HardwareSerial::flush()
+{
+  fflush(stdout);
+}
+
+/*
+ * Tasks
+ *
+ * A task is a detached thread. The control block lives until the task function returns or the task deletes
+ * itself, just like on FreeRTOS, so notifying a task that is gone is a use after free here as well.
+ */
+struct tskTaskControlBlock {
+  std::mutex lock;
+  std::condition_variable notified;
+  uint32_t notifications = 0;
+};
+
+struct TaskExit {};                         // Thrown by vTaskDelete(nullptr) to unwind the task's thread
+
+static thread_local TaskHandle_t currentTask = nullptr;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackSize, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core)
+{
+  TaskHandle_t task = new tskTaskControlBlock;
+
+  if (handle != nullptr) {
+    *handle = task;
+  }
+  std::thread([function, parameter, task]() {
+    currentTask = task;
+    try {
+      function(parameter);
+    } catch (const TaskExit&) {
+    }
+    delete task;
+  }).detach();
+  return (pdPASS);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+  if (task != nullptr && task != currentTask) {
+    fprintf(stderr, "vTaskDelete: deleting another task is not supported on the host\n");
+    abort();
+  }
+  throw TaskExit();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+void taskYIELD()
+{
+  std::this_thread::yield();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+  if (currentTask == nullptr) {
+    currentTask = new tskTaskControlBlock;  // A thread not created by xTaskCreatePinnedToCore, e.g. main()
+  }
+  return (currentTask);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+  return (0);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+  {
+    std::lock_guard<std::mutex> guard(task->lock);
+    task->notifications++;
+  }
+  task->notified.notify_one();
+  return (pdPASS);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken)
+{
+  xTaskNotifyGive(task);
+  if (higherPriorityTaskWoken != nullptr) {
+    *higherPriorityTaskWoken = pdFALSE;
+  }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait)
+{
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> guard(task->lock);
+  auto pending = [task]() { return (task->notifications > 0); };
+
+  if (ticksToWait == portMAX_DELAY) {
+    task->notified.wait(guard, pending);
+  } else {
+    task->notified.wait_for(guard, std::chrono::milliseconds(ticksToWait), pending);
+  }
+  uint32_t count = task->notifications;
+  if (count > 0) {
+    task->notifications = clearOnExit ? 0 : count - 1;
+  }
+  return (count);
+}
+
+/*
+ * Event groups
+ */
+struct EventGroupDef_t {
+  std::mutex lock;
+  std::condition_variable changed;
+  EventBits_t bits = 0;
+};
+
+EventGroupHandle_t xEventGroupCreate()
+{
+  return (new EventGroupDef_t);
+}
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t* buffer)
+{
+  return (new EventGroupDef_t);             // The buffer is too small to hold a mutex; vEventGroupDelete() frees this
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+  delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+  std::lock_guard<std::mutex> guard(group->lock);
+
+  group->bits |= bits;
+  group->changed.notify_all();
+  return (group->bits);
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+  std::lock_guard<std::mutex> guard(group->lock);
+  EventBits_t previous = group->bits;
+
+  group->bits &= ~bits;
+  return (previous);
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+  std::lock_guard<std::mutex> guard(group->lock);
+
+  return (group->bits);
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit, BaseType_t waitForAll,
+                                TickType_t ticksToWait)
+{
+  std::unique_lock<std::mutex> guard(group->lock);
+  auto satisfied = [group, bits, waitForAll]() {
+    return (waitForAll ? ((group->bits & bits) == bits) : ((group->bits & bits) != 0));
+  };
+
+  bool done;
+  if (ticksToWait == portMAX_DELAY) {
+    group->changed.wait(guard, satisfied);
+    done = true;
+  } else {
+    done = group->changed.wait_for(guard, std::chrono::milliseconds(ticksToWait), satisfied);
+  }
+  EventBits_t result = group->bits;
+  if (done && clearOnExit) {
+    group->bits &= ~bits;
+  }
+  return (result);
+}
+
+/*
+ * Critical sections. One lock for all of them, which is as strict as disabling interrupts.
+ */
+static std::recursive_mutex criticalLock;
+
+void hostEnterCritical(portMUX_TYPE* mux)
+{
+  criticalLock.lock();
+}
+
+void hostExitCritical(portMUX_TYPE* mux)
+{
+  criticalLock.unlock();
+}
+
+/*
+ * esp_timer
+ */
+struct esp_timer {
+  esp_timer_create_args_t args;
+  std::mutex lock;
+  std::condition_variable stopped;
+  std::thread thread;
+  bool running = false;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle)
+{
+  esp_timer_handle_t timer = new esp_timer;
+
+  timer->args = *args;
+  *handle = timer;
+  return (ESP_OK);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs)
+{
+  std::lock_guard<std::mutex> guard(timer->lock);
+
+  if (timer->running) {
+    return (ESP_ERR_INVALID_STATE);
+  }
+  timer->running = true;
+  timer->thread = std::thread([timer, periodUs]() {
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> guard(timer->lock);
+
+    while (timer->running) {
+      next += std::chrono::microseconds(periodUs);
+      if (timer->stopped.wait_until(guard, next, [timer]() { return (!timer->running); })) {
+        break;
+      }
+      guard.unlock();
+      timer->args.callback(timer->args.arg);
+      guard.lock();
+    }
+  });
+  return (ESP_OK);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+  {
+    std::lock_guard<std::mutex> guard(timer->lock);
+
+    if (!timer->running) {
+      return (ESP_ERR_INVALID_STATE);
+    }
+    timer->running = false;
+  }
+  timer->stopped.notify_all();
+  if (timer->thread.get_id() != std::this_thread::get_id()) {
+    timer->thread.join();
+  } else {
+    timer->thread.detach();                 // Stopped from its own callback
+  }
+  return (ESP_OK);
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+  if (timer->running) {
+    return (ESP_ERR_INVALID_STATE);
+  }
+  delete timer;
+  return (ESP_OK);
+}
+
+/*
+ * Light sleep
+ */
+static std::atomic<uint64_t> sleepTimerUs(0);
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeUs)
+{
+  sleepTimerUs = timeUs;
+  return (ESP_OK);
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup()
+{
+  return (ESP_OK);
+}
+
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t source)
+{
+  if (source == ESP_SLEEP_WAKEUP_TIMER || source == ESP_SLEEP_WAKEUP_ALL) {
+    sleepTimerUs = 0;
+  }
+  return (ESP_OK);
+}
+
+esp_err_t esp_light_sleep_start()
+{
+  if (sleepTimerUs == 0) {
+    return (ESP_ERR_INVALID_STATE);         // Only a GPIO wakeup, which never comes on the host
+  }
+  std::this_thread::sleep_for(std::chrono::microseconds(sleepTimerUs.load()));
+  return (ESP_OK);
+}
+
+/*
+ * UART
+ */
+esp_err_t uart_driver_install(uart_port_t port, int rxBufferSize, int txBufferSize, int queueSize, void* queue,
+                              int interruptFlags)
+{
+  return (ESP_OK);
+}
+
+esp_err_t uart_driver_delete(uart_port_t port)
+{
+  return (ESP_OK);
+}
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t* config)
+{
+  return (ESP_OK);
+}
+
+esp_err_t uart_set_pin(uart_port_t port, int txPin, int rxPin, int rtsPin, int ctsPin)
+{
+  return (ESP_OK);
+}
+
+esp_err_t uart_set_tx_idle_num(uart_port_t port, uint16_t idleBits)
+{
+  return (ESP_OK);
+}
+
+int uart_write_bytes(uart_port_t port, const void* data, size_t size)
+{
+  delayMicroseconds(size * HOST_UART_FRAME_BITS * HOST_UART_BIT_US);
+  return (size);
+}
+
+int uart_write_bytes_with_break(uart_port_t port, const void* data, size_t size, int breakBits)
+{
+  delayMicroseconds((size * HOST_UART_FRAME_BITS + breakBits) * HOST_UART_BIT_US);
+  return (size);
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticksToWait)
+{
+  return (ESP_OK);
+}
+
+/*
+ * Preferences
+ */
+static std::mutex preferencesLock;
+static std::map<std::string, uint8_t> preferences;
+
+bool Preferences::isKey(const char* key)
+{
+  std::lock_guard<std::mutex> guard(preferencesLock);
+
+  return (_open && preferences.count(_namespace + "/" + key) > 0);
+}
+
+bool Preferences::remove(const char* key)
+{
+  std::lock_guard<std::mutex> guard(preferencesLock);
+
+  return (_open && preferences.erase(_namespace + "/" + key) > 0);
+}
+
+bool Preferences::clear()
+{
+  std::lock_guard<std::mutex> guard(preferencesLock);
+  std::string prefix = _namespace + "/";
+
+  if (!_open) {
+    return (false);
+  }
+  for (auto it = preferences.begin(); it != preferences.end();) {
+    it = (it->first.compare(0, prefix.size(), prefix) == 0) ? preferences.erase(it) : std::next(it);
+  }
+  return (true);
+}
+
+uint8_t Preferences::getUChar(const char* key, uint8_t defaultValue)
+{
+  std::lock_guard<std::mutex> guard(preferencesLock);
+
+  if (!_open) {
+    return (defaultValue);
+  }
+  auto it = preferences.find(_namespace + "/" + key);
+  return ((it != preferences.end()) ? it->second : defaultValue);
+}
+
+size_t Preferences::putUChar(const char* key, uint8_t value)
+{
+  std::lock_guard<std::mutex> guard(preferencesLock);
+
+  if (!_open) {
+    return (0);
+  }
+  preferences[_namespace + "/" + key] = value;
+  return (1);
+}
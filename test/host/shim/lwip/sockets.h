@@ -0,0 +1,14 @@
+/*
+  lwip/sockets.h - Host shim for the lwIP socket API, which is the BSD socket API of the host
+  Released into the public domain.
+*/
+
+#ifndef HOST_LWIP_SOCKETS_h
+#define HOST_LWIP_SOCKETS_h
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#endif
@@ -0,0 +1,27 @@
+/*
+  nRF24L01.h - The nRF24L01 register map, as far as the WirelessDMXReceiver library uses it
+  Released into the public domain.
+*/
+
+#ifndef HOST_NRF24L01_h
+#define HOST_NRF24L01_h
+
+/* Commands */
+#define R_REGISTER                   0x00
+#define W_REGISTER                   0x20
+#define R_RX_PAYLOAD                 0x61
+#define FLUSH_RX                     0xE2
+#define RF24_NOP                     0xFF
+
+/* Registers */
+#define NRF_STATUS                   0x07
+#define RPD                          0x09
+#define FIFO_STATUS                  0x17
+
+/* Bits */
+#define RX_DR                           6
+#define RX_P_NO                         1
+#define RX_FULL                         1
+#define RX_EMPTY                        0
+
+#endif
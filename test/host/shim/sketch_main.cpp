@@ -0,0 +1,19 @@
+/*
+  sketch_main.cpp - Runs an example sketch on the host: setup(), then loop() once
+  Released into the public domain.
+
+  The examples built for the host do all their work in setup(), so there is no point in looping forever.
+*/
+
+#include "Arduino.h"
+
+void setup();
+void loop();
+
+int main()
+{
+  setup();
+  loop();
+  Serial.flush();
+  return (0);
+}
@@ -0,0 +1,58 @@
+/*
+  test.h - Minimal test helpers for the host tests
+  Released into the public domain.
+*/
+
+#ifndef HOST_TEST_h
+#define HOST_TEST_h
+
+#include <stdio.h>
+#include "Arduino.h"
+
+static int testFailures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      testFailures++; \
+    } \
+  } while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+  do { \
+    long long e = (long long)(expected), a = (long long)(actual); \
+    if (e != a) { \
+      fprintf(stderr, "%s:%d: CHECK_EQUAL(%s, %s) failed: expected %lld, got %lld\n", __FILE__, __LINE__, #expected, \
+              #actual, e, a); \
+      testFailures++; \
+    } \
+  } while (0)
+
+/*
+ * Poll condition until it holds or timeoutMs passed. Returns whether it held.
+ */
+template <typename Condition>
+bool waitFor(Condition condition, unsigned long timeoutMs)
+{
+  unsigned long start = millis();
+
+  while (!condition()) {
+    if (millis() - start >= timeoutMs) {
+      return (false);
+    }
+    delay(1);
+  }
+  return (true);
+}
+
+#define RUN_TEST(test) \
+  do { \
+    int before = testFailures; \
+    test(); \
+    printf("%s %s\n", (testFailures == before) ? "PASS" : "FAIL", #test); \
+  } while (0)
+
+#define TEST_RESULT() ((testFailures == 0) ? 0 : 1)
+
+#endif
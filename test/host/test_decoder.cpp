@@ -0,0 +1,177 @@
+/*
+  test_decoder.cpp - Feeds packets into WirelessDMXReceiver::processPacket() and checks the decoded frames
+*/
+
+#include <WirelessDMXReceiver.h>
+#include <WirelessDMXMockRadio.h>
+#include "test.h"
+
+#define SLOT_CHANNELS  sizeof(WirelessDMXReceiver::wdmxReceiveBuffer::dmxData)
+
+static WirelessDMXReceiver::wdmxReceiveBuffer makePacket(unsigned int payloadID, unsigned int channelCount, uint8_t offset)
+{
+  WirelessDMXReceiver::wdmxReceiveBuffer packet;
+
+  packet.magic = WDMX_MAGIC_1;
+  packet.payloadID = payloadID;
+  packet.highestChannelID = channelCount - 1;
+  for (unsigned int i = 0; i < SLOT_CHANNELS; i++) {
+    packet.dmxData[i] = (payloadID * SLOT_CHANNELS + i + offset) & 0xFF;
+  }
+  return (packet);
+}
+
+static unsigned int slotsFor(unsigned int channelCount)
+{
+  return ((channelCount + SLOT_CHANNELS - 1) / SLOT_CHANNELS);
+}
+
+static void sendUniverse(WirelessDMXReceiver& receiver, unsigned int channelCount, uint8_t offset)
+{
+  for (unsigned int i = 0; i < slotsFor(channelCount); i++) {
+    receiver.processPacket(makePacket(i, channelCount, offset));
+  }
+}
+
+static bool frameMatches(WirelessDMXReceiver& receiver, unsigned int channelCount, uint8_t offset)
+{
+  for (unsigned int address = 1; address <= channelCount; address++) {
+    if (receiver.getValue(address) != ((address - 1 + offset) & 0xFF)) {
+      return (false);
+    }
+  }
+  return (true);
+}
+
+static void testFullUniverse()
+{
+  WirelessDMXMockRadio radio(0, BLUE);
+  WirelessDMXReceiver receiver(radio);
+
+  receiver.setBufferMode(WDMX_BUFFER_TRIPLE);
+  sendUniverse(receiver, DMX_BUFSIZE, 0);
+  CHECK_EQUAL(1, receiver.frameGeneration());
+  CHECK_EQUAL(DMX_BUFSIZE, receiver.getChannelCount());
+  CHECK(frameMatches(receiver, DMX_BUFSIZE, 0));
+
+  sendUniverse(receiver, DMX_BUFSIZE, 7);
+  CHECK_EQUAL(2, receiver.frameGeneration());
+  CHECK(frameMatches(receiver, DMX_BUFSIZE, 7));
+}
+
+static void testSmallUniverse()
+{
+  WirelessDMXMockRadio radio(0, BLUE);
+  WirelessDMXReceiver receiver(radio);
+
+  receiver.setBufferMode(WDMX_BUFFER_TRIPLE);
+  for (unsigned int i = 0; i < 3; i++) {
+    sendUniverse(receiver, 96, i);
+  }
+  CHECK_EQUAL(3, receiver.frameGeneration());
+  CHECK_EQUAL(96, receiver.getChannelCount());
+  CHECK(frameMatches(receiver, 96, 2));
+  for (unsigned int slot = 0; slot < WDMX_SLOT_COUNT; slot++) {
+    CHECK_EQUAL(0, receiver.slotLosses(slot));
+  }
+}
+
+static void testInvalidMagic()
+{
+  WirelessDMXMockRadio radio(0, BLUE);
+  WirelessDMXReceiver receiver(radio);
+
+  sendUniverse(receiver, 56, 0);
+  WirelessDMXReceiver::wdmxReceiveBuffer packet = makePacket(0, 56, 100);
+  packet.magic = 0x42;
+  receiver.processPacket(packet);
+  CHECK_EQUAL(1, receiver.frameGeneration());
+  CHECK_EQUAL(0, receiver.getValue(1));
+}
+
+static void testLostSlot()
+{
+  WirelessDMXMockRadio radio(0, BLUE);
+  WirelessDMXReceiver receiver(radio);
+
+  receiver.setBufferMode(WDMX_BUFFER_TRIPLE);
+  sendUniverse(receiver, 112, 0);
+  for (unsigned int i = 0; i < slotsFor(112); i++) {
+    if (i != 2) {
+      receiver.processPacket(makePacket(i, 112, 1));
+    }
+  }
+  CHECK_EQUAL(1, receiver.slotLosses(2));
+  CHECK_EQUAL(0, receiver.slotLosses(1));
+  CHECK_EQUAL(2, receiver.frameGeneration());   // WDMX_COMPLETE_LAST_SLOT publishes anyway
+  CHECK_EQUAL(0 + 56, receiver.getValue(57));   // Slot 2 still holds the previous frame
+  CHECK_EQUAL(1 + 84, receiver.getValue(85));
+}
+
+static void testCompleteAllSlots()
+{
+  WirelessDMXMockRadio radio(0, BLUE);
+  WirelessDMXReceiver receiver(radio);
+
+  receiver.setBufferMode(WDMX_BUFFER_TRIPLE);
+  receiver.setCompletionPolicy(WDMX_COMPLETE_ALL_SLOTS, 60000);
+  sendUniverse(receiver, 112, 0);
+  CHECK_EQUAL(1, receiver.frameGeneration());
+
+  for (unsigned int i = 0; i < slotsFor(112); i++) {
+    if (i != 2) {
+      receiver.processPacket(makePacket(i, 112, 1));
+    }
+  }
+  CHECK_EQUAL(1, receiver.frameGeneration());   // Withheld: slot 2 is missing
+  receiver.processPacket(makePacket(0, 112, 1));
+  receiver.processPacket(makePacket(1, 112, 1));
+  CHECK_EQUAL(1, receiver.frameGeneration());
+  receiver.processPacket(makePacket(2, 112, 1));
+  CHECK_EQUAL(2, receiver.frameGeneration());
+  CHECK(frameMatches(receiver, 112, 1));
+}
+
+static void testSnapshot()
+{
+  WirelessDMXMockRadio radio(0, BLUE);
+  WirelessDMXReceiver receiver(radio);
+  uint8_t snapshot[DMX_BUFSIZE];
+  uint32_t generation = 0;
+
+  receiver.setBufferMode(WDMX_BUFFER_TRIPLE);
+  sendUniverse(receiver, DMX_BUFSIZE, 3);
+  CHECK(receiver.readSnapshot(snapshot, sizeof(snapshot), &generation));
+  CHECK_EQUAL(1, generation);
+  CHECK_EQUAL(3, snapshot[0]);
+  CHECK_EQUAL((511 + 3) & 0xFF, snapshot[511]);
+}
+
+static void testSubscription()
+{
+  WirelessDMXMockRadio radio(0, BLUE);
+  WirelessDMXReceiver receiver(radio);
+  uint8_t channels[4] = { 0 };
+
+  int index = receiver.subscribe(30, sizeof(channels), channels);
+  CHECK(index >= 0);
+  CHECK_EQUAL(0, receiver.subscriptionGeneration(index));
+  sendUniverse(receiver, 56, 0);
+  CHECK(receiver.subscriptionGeneration(index) > 0);
+  CHECK_EQUAL(29, channels[0]);
+  CHECK_EQUAL(32, channels[3]);
+  CHECK_EQUAL(0, receiver.subscriptionGeneration(-1));
+  CHECK_EQUAL(0, receiver.subscriptionGeneration(WDMX_MAX_SUBSCRIPTIONS));
+}
+
+int main()
+{
+  RUN_TEST(testFullUniverse);
+  RUN_TEST(testSmallUniverse);
+  RUN_TEST(testInvalidMagic);
+  RUN_TEST(testLostSlot);
+  RUN_TEST(testCompleteAllSlots);
+  RUN_TEST(testSnapshot);
+  RUN_TEST(testSubscription);
+  return (TEST_RESULT());
+}
@@ -0,0 +1,63 @@
+/*
+  test_merger.cpp - Merges two simulated transmitters with WirelessDMXMerger
+*/
+
+#include <WirelessDMXReceiver.h>
+#include <WirelessDMXMockRadio.h>
+#include <WirelessDMXMerger.h>
+#include "test.h"
+
+static void testHTP()
+{
+  WirelessDMXMockRadio radioA(10, BLUE);
+  WirelessDMXMockRadio radioB(30, RED);
+  WirelessDMXReceiver receiverA(radioA);
+  WirelessDMXReceiver receiverB(radioB);
+  WirelessDMXMerger merger(WDMX_MERGE_HTP);
+
+  radioA.setValue(1, 200);
+  radioA.setValue(2, 10);
+  radioB.setValue(1, 50);
+  radioB.setValue(2, 90);
+  receiverA.setLockPersistence(false);
+  receiverB.setLockPersistence(false);
+  CHECK(merger.add(receiverA));
+  CHECK(merger.add(receiverB));
+  CHECK(merger.begin());
+  receiverA.begin(BLUE);
+  receiverB.begin(RED);
+
+  CHECK(waitFor([&]() { return (merger.getValue(1) == 200 && merger.getValue(2) == 90); }, 2000));
+  CHECK_EQUAL(0, merger.getValue(3));
+}
+
+static void testFailover()
+{
+  WirelessDMXMockRadio primary(10, BLUE);
+  WirelessDMXMockRadio backup(30, RED);
+  WirelessDMXReceiver receiverA(primary);
+  WirelessDMXReceiver receiverB(backup);
+  WirelessDMXMerger merger(WDMX_MERGE_FAILOVER);
+
+  primary.setValue(1, 1);
+  backup.setValue(1, 2);
+  receiverA.setLockPersistence(false);
+  receiverB.setLockPersistence(false);
+  CHECK(merger.add(receiverA));
+  CHECK(merger.add(receiverB));
+  CHECK(merger.begin());
+  receiverA.begin(BLUE);
+  receiverB.begin(RED);
+
+  CHECK(waitFor([&]() { return (merger.activeSource() == 0 && merger.getValue(1) == 1); }, 2000));
+  primary.setTransmitterEnabled(false);
+  CHECK(waitFor([&]() { return (merger.activeSource() == 1 && merger.getValue(1) == 2); }, 1000));
+  CHECK(merger.failovers() >= 1);
+}
+
+int main()
+{
+  RUN_TEST(testHTP);
+  RUN_TEST(testFailover);
+  return (TEST_RESULT());
+}
@@ -0,0 +1,97 @@
+/*
+  test_mock_radio.cpp - Runs WirelessDMXReceiver against WirelessDMXMockRadio: scanning, receiving, signal loss and
+  re-acquisition
+*/
+
+#include <WirelessDMXReceiver.h>
+#include <WirelessDMXMockRadio.h>
+#include "test.h"
+
+static void setPattern(WirelessDMXMockRadio& radio, uint8_t offset)
+{
+  uint8_t universe[DMX_BUFSIZE];
+
+  for (unsigned int i = 0; i < sizeof(universe); i++) {
+    universe[i] = (i + offset) & 0xFF;
+  }
+  radio.setUniverse(universe, sizeof(universe));
+}
+
+static void testReceive()
+{
+  WirelessDMXMockRadio radio(42, BLUE);
+  WirelessDMXReceiver receiver(radio);
+
+  setPattern(radio, 5);
+  receiver.setLockPersistence(false);
+  receiver.setBufferMode(WDMX_BUFFER_TRIPLE);
+  receiver.begin(BLUE);
+  CHECK(receiver.isLocked());
+  CHECK_EQUAL(42, receiver.getChannel());
+  CHECK(waitFor([&]() { return (receiver.frameGeneration() >= 3); }, 1000));
+  CHECK_EQUAL(DMX_BUFSIZE, receiver.getChannelCount());
+  CHECK_EQUAL(5, receiver.getValue(1));
+  CHECK_EQUAL((511 + 5) & 0xFF, receiver.getValue(512));
+
+  radio.setValue(100, 0xAA);
+  CHECK(waitFor([&]() { return (receiver.getValue(100) == 0xAA); }, 1000));
+  CHECK(radio.packetsReceived() > 0);
+  receiver.end();
+}
+
+static void testAutoScan()
+{
+  WirelessDMXMockRadio radio(64, GREEN);
+  WirelessDMXReceiver receiver(radio);
+
+  receiver.setLockPersistence(false);
+  receiver.begin(AUTO);
+  CHECK(receiver.isLocked());
+  CHECK_EQUAL(64, receiver.getChannel());
+  CHECK_EQUAL(GREEN, receiver.getId());
+  receiver.end();
+}
+
+static void testSignalLoss()
+{
+  WirelessDMXMockRadio radio(20, BLUE);
+  WirelessDMXReceiver receiver(radio);
+
+  receiver.setLockPersistence(false);
+  receiver.begin(BLUE);
+  CHECK(receiver.isLocked());
+
+  radio.setTransmitterEnabled(false);
+  CHECK(waitFor([&]() { return (!receiver.isLocked()); }, WDMX_SIGNAL_TIMEOUT_MS + 500));
+
+  radio.setTransmitter(22, BLUE);
+  radio.setTransmitterEnabled(true);
+  CHECK(receiver.waitForLock(5000));
+  CHECK_EQUAL(22, receiver.getChannel());
+  receiver.end();
+}
+
+static void testEnd()
+{
+  WirelessDMXMockRadio* radio = new WirelessDMXMockRadio(10, RED);
+  WirelessDMXReceiver* receiver = new WirelessDMXReceiver(*radio);
+
+  receiver->setLockPersistence(false);
+  receiver->begin(RED);
+  CHECK(waitFor([&]() { return (receiver->frameGeneration() > 0); }, 1000));
+  receiver->end();
+  uint32_t generation = receiver->frameGeneration();
+  delay(50);
+  CHECK_EQUAL(generation, receiver->frameGeneration());   // Nothing receives any more
+  delete receiver;
+  delete radio;
+}
+
+int main()
+{
+  RUN_TEST(testReceive);
+  RUN_TEST(testAutoScan);
+  RUN_TEST(testSignalLoss);
+  RUN_TEST(testEnd);
+  return (TEST_RESULT());
+}